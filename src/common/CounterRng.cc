@@ -0,0 +1,29 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "common/CounterRng.h"
+
+uint64_t CounterRng::makeKey(uint64_t seed, uint64_t streamId)
+{
+    return mix(mix(seed) ^ (streamId * 0xD1B54A32D192ED03ULL));
+}
+
+uint32_t CounterRng::intRand(uint32_t n)
+{
+    if (n == 0)
+        throw cRuntimeError("CounterRng::intRand - the range must not be empty");
+
+    // reject the top values that would bias the modulo
+    uint32_t limit = 0xFFFFFFFFU - (0xFFFFFFFFU % n + 1) % n;
+    uint32_t value;
+    do
+        value = intRand();
+    while (value > limit);
+    return value % n;
+}
@@ -0,0 +1,86 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_COUNTERRNG_H_
+#define _LTE_COUNTERRNG_H_
+
+#include <omnetpp.h>
+#include <stdint.h>
+
+using namespace omnetpp;
+
+/**
+ * Counter-based random number stream.
+ *
+ * The i-th number of the stream is a pure function of (key, i), namely the
+ * SplitMix64 finalizer applied to key + i * golden ratio, so a stream only
+ * depends on its key and on how many numbers its owner drew. Streams with
+ * different keys can therefore be used concurrently by different threads
+ * and still give the same sequence whatever the thread count and the order
+ * in which the threads run.
+ */
+class CounterRng : public cRNG
+{
+  protected:
+    uint64_t key_;
+    uint64_t counter_;
+
+    static uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t next()
+    {
+        return mix(key_ + (++counter_) * 0x9E3779B97F4A7C15ULL);
+    }
+
+  public:
+    explicit CounterRng(uint64_t key = 0)
+    {
+        key_ = key;
+        counter_ = 0;
+    }
+
+    /**
+     * Mixes the given values into a stream key
+     */
+    static uint64_t makeKey(uint64_t seed, uint64_t streamId);
+
+    virtual unsigned long getNumbersDrawn() const
+    {
+        return counter_;
+    }
+    virtual uint32_t intRand()
+    {
+        return (uint32_t)(next() >> 32);
+    }
+    virtual uint32_t intRandMax()
+    {
+        return 0xFFFFFFFFU;
+    }
+    virtual uint32_t intRand(uint32_t n);
+    virtual double doubleRand()
+    {
+        // 53 random bits in [0,1)
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    virtual double doubleRandNonz()
+    {
+        return ((next() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+    virtual double doubleRandIncl1()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740991.0);
+    }
+};
+
+#endif
@@ -794,6 +794,97 @@ struct UeInfo
     LtePhyBase* phy;
 };
 
+/*
+ * Snapshot of a UE transmission, kept by the binder for interference computation
+ */
+struct ActiveTransmitter
+{
+    MacNodeId id;
+    unsigned long order;            // position of the UE in the binder's UE list
+    LtePhyBase* phy;
+    inet::Coord coord;              // position at transmission time
+    double txPwr;                   // dBm
+    std::vector<bool> usedBands;    // bands occupied on the MACRO antenna
+    double usedBandCount;           // number of occupied bands, over all the transmissions of the TTI
+};
+
+/*
+ * Per-band measurements of a received D2D frame: RSRP and RSSI in dBm, SINR in dB,
+ * plus the attenuation (dB) of the link. A record is meant to be reused: once sized
+ * for the number of bands, filling it again does not allocate.
+ */
+struct BandMeasurements
+{
+    std::vector<double> rsrpVector;
+    std::vector<double> rssiVector;
+    std::vector<double> sinrVector;
+    double attenuation;
+
+    BandMeasurements() : attenuation(0.0) {}
+
+    // Sizes the vectors for numBands bands, returns how many had to be reallocated
+    unsigned int resize(unsigned int numBands)
+    {
+        unsigned int allocations = 0;
+        allocations += (rsrpVector.capacity() < numBands);
+        allocations += (rssiVector.capacity() < numBands);
+        allocations += (sinrVector.capacity() < numBands);
+        rsrpVector.resize(numBands);
+        rssiVector.resize(numBands);
+        sinrVector.resize(numBands);
+        return allocations;
+    }
+};
+
+/*
+ * Free list of BandMeasurements records. A record is handed out by acquire() and
+ * given back by release(); once the pool has warmed up, a receiver cycles through
+ * the same records and the steady state does not allocate.
+ */
+class BandMeasurementsPool
+{
+    std::vector<BandMeasurements*> free_;
+    // Number of records allocated or grown since the pool was built
+    unsigned long allocations_;
+
+  public:
+    BandMeasurementsPool() : allocations_(0) {}
+
+    ~BandMeasurementsPool()
+    {
+        for (unsigned int i = 0; i < free_.size(); i++)
+            delete free_[i];
+    }
+
+    // Returns a record sized for numBands bands, whose content is left over from its previous use
+    BandMeasurements* acquire(unsigned int numBands)
+    {
+        BandMeasurements* measurements;
+        if (free_.empty())
+        {
+            measurements = new BandMeasurements();
+            allocations_++;
+        }
+        else
+        {
+            measurements = free_.back();
+            free_.pop_back();
+        }
+        allocations_ += measurements->resize(numBands);
+        return measurements;
+    }
+
+    void release(BandMeasurements* measurements)
+    {
+        free_.push_back(measurements);
+    }
+
+    unsigned long getAllocations() const
+    {
+        return allocations_;
+    }
+};
+
 typedef std::vector<ExtCell*> ExtCellList;
 
 /*****************
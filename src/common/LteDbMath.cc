@@ -0,0 +1,48 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#if defined(LTE_FAST_DB_MATH) && defined(__GNUC__) && !defined(__clang__)
+// let GCC evaluate both sides of the selects in fastExp10/fastLog10, which is
+// what allows it to vectorize the loops (the model never enables FP traps)
+#pragma GCC optimize ("no-trapping-math")
+#endif
+
+#include "common/LteDbMath.h"
+
+#ifdef LTE_FAST_DB_MATH
+#define LTE_EXP10(x) fastExp10(x)
+#define LTE_LOG10(x) fastLog10(x)
+#else
+#define LTE_EXP10(x) std::pow(10.0, x)
+#define LTE_LOG10(x) std::log10(x)
+#endif
+
+void dBToLinear(const double* db, double* linear, unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i++)
+        linear[i] = LTE_EXP10(db[i] / 10);
+}
+
+void dBmToLinear(const double* dbm, double* linear, unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i++)
+        linear[i] = LTE_EXP10((dbm[i] - 30) / 10);
+}
+
+void linearToDb(const double* linear, double* db, unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i++)
+        db[i] = 10 * LTE_LOG10(linear[i]);
+}
+
+void linearToDBm(const double* linear, double* dbm, unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i++)
+        dbm[i] = 10 * LTE_LOG10(1000 * linear[i]);
+}
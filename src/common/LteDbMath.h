@@ -0,0 +1,97 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_LTEDBMATH_H_
+#define _LTE_LTEDBMATH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+/**
+ * Batch conversions between dB and linear values, used by the per-band loops
+ * of the channel model. Input and output may be the same array.
+ *
+ * By default every element goes through pow/log10, exactly as the scalar
+ * versions in LteCommon.h. Defining LTE_FAST_DB_MATH (make FAST_DB_MATH=1)
+ * switches to fastExp10/fastLog10, which are branch free: GCC vectorizes the
+ * loops at -O3 (release mode), with the SSE2 or AVX2 width of the target.
+ */
+void dBToLinear(const double* db, double* linear, unsigned int n);
+void dBmToLinear(const double* dbm, double* linear, unsigned int n);
+void linearToDb(const double* linear, double* db, unsigned int n);
+void linearToDBm(const double* linear, double* dbm, unsigned int n);
+
+/**
+ * 10^x with relative error below 1e-10.
+ * Returns 0 below 10^-307 and HUGE_VAL above 10^307, NaN is passed through.
+ *
+ * There is no branch and no conversion between double and int64_t (the
+ * rounding uses the 1.5 * 2^52 trick), so that loops over it vectorize.
+ */
+inline double fastExp10(double x)
+{
+    // 10^x = 2^(x * log2(10)) = 2^k * e^(f * ln(2)), with k integer and |f| <= 0.5
+    double t = x * 3.32192809488736234787;
+    double tc = std::min(std::max(t, -1022.0), 1023.0);
+    double kd = tc + 6755399441055744.0;
+    int64_t kbits;
+    std::memcpy(&kbits, &kd, sizeof(double));
+    double k = kd - 6755399441055744.0;
+    double f = (tc - k) * 0.69314718055994530942;
+    double p = 1 + f * (1 + f * (1.0 / 2 + f * (1.0 / 6 + f * (1.0 / 24 + f * (1.0 / 120 + f * (1.0 / 720
+        + f * (1.0 / 5040 + f * (1.0 / 40320 + f * (1.0 / 362880)))))))));
+    // the low bits of kd hold k
+    int64_t bits = (kbits - 0x4338000000000000LL + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &bits, sizeof(double));
+    double r = p * scale;
+    r = (t < -1022) ? 0.0 : r;
+    r = (t > 1023) ? HUGE_VAL : r;
+    return (t != t) ? t : r;
+}
+
+/**
+ * log10(x) with absolute error below 1e-10.
+ * Returns -HUGE_VAL for zero, NaN for negative values and NaN, HUGE_VAL
+ * for HUGE_VAL. Subnormal values are scaled into the normal range.
+ *
+ * There is no branch and no conversion between double and int64_t, so that
+ * loops over it vectorize.
+ */
+inline double fastLog10(double x)
+{
+    // scale subnormal values by 2^54
+    bool subnormal = x < 2.2250738585072014e-308;
+    double xs = subnormal ? x * 18014398509481984.0 : x;
+    // xs = m * 2^e, with m in [sqrt(2)/2, sqrt(2))
+    int64_t bits;
+    std::memcpy(&bits, &xs, sizeof(double));
+    int64_t ebits = ((bits >> 52) & 0x7ff) + 0x4338000000000000LL;
+    double e;
+    std::memcpy(&e, &ebits, sizeof(double));
+    e = e - 6755399441055744.0 - (subnormal ? 1023.0 + 54.0 : 1023.0);
+    bits = (bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL;
+    double m;
+    std::memcpy(&m, &bits, sizeof(double));
+    bool high = m > 1.41421356237309504880;
+    m = high ? m * 0.5 : m;
+    e = high ? e + 1 : e;
+    // ln(m) = 2 atanh(s), with s = (m - 1) / (m + 1) and |s| <= 0.172
+    double s = (m - 1) / (m + 1);
+    double s2 = s * s;
+    double lnm = 2 * s * (1 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 * (1.0 / 7 + s2 * (1.0 / 9 + s2 * (1.0 / 11))))));
+    double r = (e * 0.69314718055994530942 + lnm) * 0.43429448190325182765;
+    r = (x == HUGE_VAL) ? HUGE_VAL : r;
+    r = (x == 0) ? -HUGE_VAL : r;
+    return (x >= 0) ? r : NAN;
+}
+
+#endif
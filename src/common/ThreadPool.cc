@@ -0,0 +1,112 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include <algorithm>
+#include "common/ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1U, std::thread::hardware_concurrency());
+
+    task_ = NULL;
+    numTasks_ = 0;
+    nextTask_ = 0;
+    busyWorkers_ = 0;
+    generation_ = 0;
+    stop_ = false;
+
+    for (unsigned int i = 1; i < numThreads; i++)
+        workers_.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    startCondition_.notify_all();
+    for (unsigned int i = 0; i < workers_.size(); i++)
+        workers_[i].join();
+}
+
+void ThreadPool::runTasks()
+{
+    unsigned int i;
+    while ((i = nextTask_++) < numTasks_)
+    {
+        try
+        {
+            (*task_)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_)
+                error_ = std::current_exception();
+            // skip the remaining iterations
+            nextTask_ = numTasks_;
+        }
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned long seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            startCondition_.wait(lock, [&] { return stop_ || generation_ != seenGeneration; });
+            if (stop_)
+                return;
+            seenGeneration = generation_;
+        }
+
+        runTasks();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busyWorkers_ == 0)
+            doneCondition_.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(unsigned int n, const std::function<void(unsigned int)>& task)
+{
+    if (n == 0)
+        return;
+
+    task_ = &task;
+    numTasks_ = n;
+    nextTask_ = 0;
+    error_ = std::exception_ptr();
+
+    // no point in waking up the workers for a single iteration
+    if (!workers_.empty() && n > 1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busyWorkers_ = workers_.size();
+            generation_++;
+        }
+        startCondition_.notify_all();
+
+        runTasks();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        doneCondition_.wait(lock, [&] { return busyWorkers_ == 0; });
+    }
+    else
+        runTasks();
+
+    task_ = NULL;
+    if (error_)
+        std::rethrow_exception(error_);
+}
@@ -0,0 +1,70 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_THREADPOOL_H_
+#define _LTE_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads running the iterations of a loop.
+ *
+ * parallelFor() hands the indices out one at a time, so there is no
+ * guarantee about which thread runs an iteration nor in which order:
+ * iterations must not depend on each other. The calling thread takes part in
+ * the loop, hence a pool of one thread runs everything inline.
+ */
+class ThreadPool
+{
+  protected:
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable startCondition_;
+    std::condition_variable doneCondition_;
+
+    // loop being run, changed under mutex_ only while no worker is busy
+    const std::function<void(unsigned int)>* task_;
+    unsigned int numTasks_;
+    std::atomic<unsigned int> nextTask_;
+    unsigned int busyWorkers_;
+    unsigned long generation_;
+    bool stop_;
+
+    // first exception thrown by an iteration, rethrown by parallelFor()
+    std::exception_ptr error_;
+
+    void workerLoop();
+    void runTasks();
+
+  public:
+    /**
+     * @param numThreads total number of threads, the caller included (0 = one per hardware thread)
+     */
+    explicit ThreadPool(unsigned int numThreads);
+    ~ThreadPool();
+
+    unsigned int getNumThreads() const
+    {
+        return workers_.size() + 1;
+    }
+
+    /**
+     * Runs task(0) ... task(n - 1) and returns when all of them completed
+     */
+    void parallelFor(unsigned int n, const std::function<void(unsigned int)>& task);
+};
+
+#endif
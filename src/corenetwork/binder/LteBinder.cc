@@ -11,7 +11,9 @@
 #include "corenetwork/deployer/LteDeployer.h"
 #include "inet/networklayer/common/L3AddressResolver.h"
 #include <cctype>
+#include <algorithm>
 #include "corenetwork/nodes/InternetMux.h"
+#include "stack/phy/layer/LtePhyBase.h"
 
 using namespace std;
 
@@ -745,6 +747,20 @@ void LteBinder::initialize(int stage)
         }
         nodesConfigured_ = false;
 
+        activeTransmitterGridCellSize_ = par("activeTransmitterGridCellSize");
+        if (activeTransmitterGridCellSize_ <= 0)
+            throw cRuntimeError("LteBinder::initialize - activeTransmitterGridCellSize must be positive");
+
+        double blerTableStep = par("blerTableStep");
+        double blerTableTolerance = par("blerTableTolerance");
+        if (blerTableStep < 0)
+            throw cRuntimeError("LteBinder::initialize - blerTableStep must not be negative");
+        double blerTableError = phyPisaData.initBlerTables(blerTableStep);
+        if (blerTableError > blerTableTolerance)
+            throw cRuntimeError("LteBinder::initialize - BLER tables sampled every %g dB deviate by %g from the BLER curves, "
+                    "above blerTableTolerance %g: use a smaller blerTableStep", blerTableStep, blerTableError, blerTableTolerance);
+        recordScalar("blerTableMaxError", blerTableError);
+
         // execute node creation and setup.
         // nodesConfiguration();
     }
@@ -1001,3 +1017,159 @@ void LteBinder::removeUeHandoverTriggered(MacNodeId nodeId)
 {
     ueHandoverTriggered_.erase(nodeId);
 }
+
+void LteBinder::registerActiveTransmitter(LtePhyBase* phy, MacNodeId nodeId, const Coord& coord, double txPwr, const RbMap& rbMap)
+{
+    std::map<MacNodeId, unsigned long>::iterator oit = ueOrder_.find(nodeId);
+    if (oit == ueOrder_.end())
+        return;   // the UE is not in the UE list, hence it is never considered as interferer
+
+    if (activeTransmittersTime_[0] != NOW)
+    {
+        // first transmission of this TTI, rotate the lists
+        if (activeTransmittersTime_[0] == NOW - TTI)
+        {
+            activeTransmitters_[1].swap(activeTransmitters_[0]);
+            activeTransmittersTime_[1] = activeTransmittersTime_[0];
+            activeTransmitterGrid_[1].swap(activeTransmitterGrid_[0]);
+            activeTransmitterGridValid_[1] = activeTransmitterGridValid_[0];
+        }
+        else
+        {
+            activeTransmitters_[1].clear();
+            activeTransmittersTime_[1] = -1;
+            activeTransmitterGridValid_[1] = false;
+        }
+        activeTransmitters_[0].clear();
+        activeTransmittersTime_[0] = NOW;
+        activeTransmitterGridValid_[0] = false;
+    }
+
+    std::vector<bool> usedBands(numBands_, false);
+    double usedBandCount = 0.0;
+    RbMap::const_iterator rit = rbMap.find(MACRO);
+    if (rit != rbMap.end())
+    {
+        std::map<Band, unsigned int>::const_iterator bit = rit->second.begin();
+        for (; bit != rit->second.end(); ++bit)
+        {
+            if (bit->first < numBands_ && bit->second != 0)
+            {
+                usedBands[bit->first] = true;
+                usedBandCount++;
+            }
+        }
+    }
+
+    // keep the list sorted as the UE list
+    unsigned long order = oit->second;
+    std::vector<ActiveTransmitter>& current = activeTransmitters_[0];
+    std::vector<ActiveTransmitter>::iterator it = std::lower_bound(current.begin(), current.end(), order,
+            [](const ActiveTransmitter& tx, unsigned long order) { return tx.order < order; });
+
+    if (it != current.end() && it->order == order)
+    {
+        it->usedBandCount += usedBandCount;
+        return;
+    }
+
+    activeTransmitterGridValid_[0] = false;
+
+    ActiveTransmitter tx;
+    tx.id = nodeId;
+    tx.order = order;
+    tx.phy = phy;
+    tx.coord = coord;
+    tx.txPwr = txPwr;
+    tx.usedBands = usedBands;
+    tx.usedBandCount = usedBandCount;
+    current.insert(it, tx);
+}
+
+void LteBinder::indexActiveTransmitters(simtime_t tti)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (activeTransmittersTime_[i] == tti && !activeTransmitterGridValid_[i])
+            buildActiveTransmitterGrid(i);
+    }
+}
+
+const std::vector<ActiveTransmitter>& LteBinder::getActiveTransmitters(simtime_t tti)
+{
+    if (activeTransmittersTime_[0] == tti)
+        return activeTransmitters_[0];
+    if (activeTransmittersTime_[1] == tti)
+        return activeTransmitters_[1];
+    return noActiveTransmitters_;
+}
+
+void LteBinder::buildActiveTransmitterGrid(int list)
+{
+    std::map<GridCell, std::vector<unsigned int> >& grid = activeTransmitterGrid_[list];
+    grid.clear();
+    const std::vector<ActiveTransmitter>& transmitters = activeTransmitters_[list];
+    for (unsigned int i = 0; i < transmitters.size(); i++)
+    {
+        const Coord& position = transmitters[i].coord;
+        GridCell cell((int)floor(position.x / activeTransmitterGridCellSize_), (int)floor(position.y / activeTransmitterGridCellSize_));
+        grid[cell].push_back(i);
+    }
+    activeTransmitterGridValid_[list] = true;
+}
+
+void LteBinder::getActiveTransmittersInRange(simtime_t tti, const Coord& center, double range,
+        std::vector<const ActiveTransmitter*>& transmitters)
+{
+    transmitters.clear();
+
+    int index;
+    if (activeTransmittersTime_[0] == tti)
+        index = 0;
+    else if (activeTransmittersTime_[1] == tti)
+        index = 1;
+    else
+        return;
+
+    if (!activeTransmitterGridValid_[index])
+        buildActiveTransmitterGrid(index);
+
+    int minX = (int)floor((center.x - range) / activeTransmitterGridCellSize_);
+    int maxX = (int)floor((center.x + range) / activeTransmitterGridCellSize_);
+    int minY = (int)floor((center.y - range) / activeTransmitterGridCellSize_);
+    int maxY = (int)floor((center.y + range) / activeTransmitterGridCellSize_);
+
+    const std::vector<ActiveTransmitter>& list = activeTransmitters_[index];
+    for (int x = minX; x <= maxX; x++)
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            std::map<GridCell, std::vector<unsigned int> >::const_iterator git = activeTransmitterGrid_[index].find(GridCell(x, y));
+            if (git == activeTransmitterGrid_[index].end())
+                continue;
+            std::vector<unsigned int>::const_iterator it = git->second.begin();
+            for (; it != git->second.end(); ++it)
+                transmitters.push_back(&list[*it]);
+        }
+    }
+
+    // restore the order of the list, i.e. of the UE list
+    std::sort(transmitters.begin(), transmitters.end());
+}
+
+void LteBinder::removeActiveTransmitter(MacNodeId nodeId)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        std::vector<ActiveTransmitter>::iterator it = activeTransmitters_[i].begin();
+        for (; it != activeTransmitters_[i].end(); ++it)
+        {
+            if (it->id == nodeId)
+            {
+                activeTransmitters_[i].erase(it);
+                activeTransmitterGridValid_[i] = false;
+                break;
+            }
+        }
+    }
+}
@@ -17,6 +17,7 @@
 #include "inet/networklayer/contract/ipv4/IPv4Address.h"
 #include "inet/networklayer/common/L3Address.h"
 #include "corenetwork/binder/PhyPisaData.h"
+#include "corenetwork/binder/PositionHistory.h"
 #include "corenetwork/nodes/ExtCell.h"
 #include "stack/mac/layer/LteMacBase.h"
 
@@ -67,6 +68,35 @@ class LteBinder : public cSimpleModule
     // list of all UEs. Used for inter-cell interference evaluation
     std::vector<UeInfo*> ueList_;
 
+    // insertion order in ueList_ of each UE, used to keep the active transmitters sorted as the UE list
+    std::map<MacNodeId, unsigned long> ueOrder_;
+    // next insertion order to be assigned
+    unsigned long ueOrderCounter_;
+
+    /*
+     * Active transmitters support
+     */
+    // UEs that transmitted in the last TTI [0] and in the one before it [1], sorted as the UE list
+    std::vector<ActiveTransmitter> activeTransmitters_[2];
+    // TTI each list refers to
+    simtime_t activeTransmittersTime_[2];
+    // returned when no list refers to the requested TTI
+    std::vector<ActiveTransmitter> noActiveTransmitters_;
+
+    /*
+     * Spatial index of the active transmitters
+     */
+    typedef std::pair<int, int> GridCell;
+    // positions in activeTransmitters_[i] of the UEs lying in each square cell of the grid
+    std::map<GridCell, std::vector<unsigned int> > activeTransmitterGrid_[2];
+    // false if activeTransmitters_[i] changed since its grid was built
+    bool activeTransmitterGridValid_[2];
+    // side of the grid cells (m)
+    double activeTransmitterGridCellSize_;
+
+    // builds the grid of activeTransmitters_[list]
+    void buildActiveTransmitterGrid(int list);
+
     MacNodeId macNodeIdCounter_[3]; // MacNodeId Counter
     DeployedUesMap dMap_; // DeployedUes --> Master Mapping
     QCIParameters QCIParam_[LTE_QCI_CLASSES];
@@ -152,6 +182,10 @@ class LteBinder : public cSimpleModule
         macNodeIdCounter_[0] = ENB_MIN_ID;
         macNodeIdCounter_[1] = RELAY_MIN_ID;
         macNodeIdCounter_[2] = UE_MIN_ID;
+        ueOrderCounter_ = 0;
+        activeTransmittersTime_[0] = activeTransmittersTime_[1] = -1;
+        activeTransmitterGridValid_[0] = activeTransmitterGridValid_[1] = false;
+        activeTransmitterGridCellSize_ = 1500;
     }
 
     unsigned int getNumBands()
@@ -348,6 +382,8 @@ class LteBinder : public cSimpleModule
      */
     ConnectedUesMap getDeployedUes(MacNodeId localId, Direction dir);
     PhyPisaData phyPisaData;
+    // recent positions and speed of every node, shared by the channel models
+    PositionHistory positionHistory;
 
     int getNodeCount(){
         return nodeIds_.size();
@@ -377,6 +413,7 @@ class LteBinder : public cSimpleModule
     void addUeInfo(UeInfo* info)
     {
         ueList_.push_back(info);
+        ueOrder_[info->id] = ueOrderCounter_++;
     }
 
     std::vector<UeInfo*> * getUeList()
@@ -395,8 +432,40 @@ class LteBinder : public cSimpleModule
                 break;
             }
         }
+        ueOrder_.erase(info->id);
+        removeActiveTransmitter(info->id);
     }
 
+    /*
+     * Active transmitters support
+     */
+    // remove the UE from the lists of active transmitters
+    void removeActiveTransmitter(MacNodeId nodeId);
+    /*
+     * Records a transmission performed by the UE in the current TTI. The list of the
+     * current TTI is rotated to the previous one when the first transmission of a new TTI
+     * is registered. Multiple transmissions of the same UE within the TTI are merged: the
+     * band occupation of the first one is kept, while the number of used bands is summed
+     */
+    void registerActiveTransmitter(LtePhyBase* phy, MacNodeId nodeId, const inet::Coord& coord, double txPwr, const RbMap& rbMap);
+    // returns the UEs that transmitted in the given TTI (only the current and the previous TTI are kept)
+    const std::vector<ActiveTransmitter>& getActiveTransmitters(simtime_t tti);
+    /*
+     * Fills <transmitters> with the UEs that transmitted in the given TTI and lie in the grid
+     * cells overlapping the square of side 2*range centered in <center>. They are returned in
+     * the same order as getActiveTransmitters(), so that the result of any computation iterating
+     * over them does not depend on the index. Note that they are a superset of those within
+     * <range>: callers must still check the actual distance
+     */
+    void getActiveTransmittersInRange(simtime_t tti, const inet::Coord& center, double range,
+            std::vector<const ActiveTransmitter*>& transmitters);
+    /*
+     * Builds the spatial index of the UEs that transmitted in the given TTI, if it is not up to date.
+     * getActiveTransmittersInRange() does it on demand, hence this is only needed before querying
+     * from several threads at once
+     */
+    void indexActiveTransmitters(simtime_t tti);
+
     Cqi meanCqi(std::vector<Cqi> bandCqi,MacNodeId id,Direction dir);
 
     /*
@@ -2648,6 +2648,8 @@ PhyPisaData::PhyPisaData()
     memcpy(blerCurves_, blerCurvesNew, sizeof(double) * 3 * 15 * 49);
     memcpy(lambdaTable_, lambdaTable, sizeof(double) * 10000 * 3);
     channel_.resize(10000);
+    blerTableStep_ = 0;
+    blerTableInvStep_ = 0;
     double x, y;
     for (int i = 0; i < 1000; i++)
     {
@@ -3028,40 +3030,123 @@ double
 PhyPisaData::GetBlerValue (const double (*xtable)[XTABLE_SIZE], const double (*ytable), const uint16_t ysize, uint16_t mcs, uint8_t harq, double sinr)
 {
 //  NS_LOG_FUNCTION (mcs << (uint16_t) harq << sinr);
-  double sinrLin = dBToLinear(sinr);
   int16_t rIndex = GetRowIndex (mcs, harq);
+  return InterpolateBler (xtable[rIndex], ytable + rIndex * ysize, sinr);
+}
+
+double
+PhyPisaData::InterpolateBler (const double *xrow, const double *yrow, double sinr)
+{
+  double sinrLin = dBToLinear(sinr);
   double bler = 1;
 
-//  NS_LOG_DEBUG ("sinrDb=" << sinrDb << " min=" << xtable[rIndex][0] << " max=" << xtable[rIndex][1]);
-  if (sinr < xtable[rIndex][0])
+//  NS_LOG_DEBUG ("sinrDb=" << sinrDb << " min=" << xrow[0] << " max=" << xrow[1]);
+  if (sinr < xrow[0])
     {
       bler = 1;
     }
-  else if (sinr  > xtable[rIndex][1])
+  else if (sinr  > xrow[1])
     {
       bler = 0;
     }
   else
     {
-      int16_t index1 = std::floor ((sinr - xtable[rIndex][0]) / xtable[rIndex][2]);
-      int16_t index2 = std::ceil ((sinr - xtable[rIndex][0]) / xtable[rIndex][2]);
+      int16_t index1 = std::floor ((sinr - xrow[0]) / xrow[2]);
+      int16_t index2 = std::ceil ((sinr - xrow[0]) / xrow[2]);
       if (index1 != index2)
         {
           //interpolate
-          double sinr1 = std::pow (10, (xtable[rIndex][0] + index1 * xtable[rIndex][2]) / 10);
-          double sinr2 = std::pow (10, (xtable[rIndex][0] + index2 * xtable[rIndex][2]) / 10);
-          double bler1 = ytable[rIndex * ysize + index1];
-          double bler2 = ytable[rIndex * ysize + index2];
+          double sinr1 = std::pow (10, (xrow[0] + index1 * xrow[2]) / 10);
+          double sinr2 = std::pow (10, (xrow[0] + index2 * xrow[2]) / 10);
+          double bler1 = yrow[index1];
+          double bler2 = yrow[index2];
           bler = bler1 + (bler2 - bler1) * (sinrLin - sinr1) / (sinr2 - sinr1);
         }
       else
         {
-          bler = ytable[rIndex * ysize + index1];
+          bler = yrow[index1];
         }
     }
   return bler;
 }
 
+double
+PhyPisaData::BuildBlerTable (const double *xrow, const double *yrow, BlerTable& table)
+{
+  table.minSinr = xrow[0];
+  table.maxSinr = xrow[1];
+  if (xrow[1] <= xrow[0] || xrow[2] <= 0)
+    {
+      // no curve for this row, the BLER is a step at minSinr
+      table.maxSinr = xrow[0];
+      table.bler.assign (1, yrow[0]);
+      return 0;
+    }
+
+  unsigned int size = (unsigned int) ((table.maxSinr - table.minSinr) * blerTableInvStep_ + 0.5) + 1;
+  table.bler.resize (size);
+  for (unsigned int i = 0; i < size; i++)
+    {
+      double sinr = std::min (table.minSinr + i * blerTableStep_, table.maxSinr);
+      table.bler[i] = InterpolateBler (xrow, yrow, sinr);
+    }
+
+  // the interpolation between samples is the farthest from the curve halfway between them
+  double maxError = 0;
+  for (unsigned int i = 0; i + 1 < size; i++)
+    {
+      double sinr = std::min (table.minSinr + (i + 0.5) * blerTableStep_, table.maxSinr);
+      maxError = std::max (maxError, std::fabs (lookupBler (table, sinr) - InterpolateBler (xrow, yrow, sinr)));
+    }
+  return maxError;
+}
+
+double
+PhyPisaData::initBlerTables (double step)
+{
+  psschBlerTables_.clear ();
+  blerTableStep_ = step;
+  if (step <= 0)
+    {
+      blerTableStep_ = 0;
+      return 0;
+    }
+  blerTableInvStep_ = 1 / step;
+
+  double maxError = 0;
+  // PSSCH rows of the first transmission, for every MCS present in the table
+  unsigned int numMcs = (sizeof (PuschAwgnSisoBlerCurveXaxis) / sizeof (PuschAwgnSisoBlerCurveXaxis[0]) + 3) / 4;
+  psschBlerTables_.resize (numMcs);
+  for (unsigned int mcs = 0; mcs < numMcs; mcs++)
+    {
+      int16_t rIndex = 4 * mcs;
+      double error = BuildBlerTable (PuschAwgnSisoBlerCurveXaxis[rIndex], PuschAwgnSisoBlerCurveYaxis + rIndex * PUSCH_AWGN_SIZE, psschBlerTables_[mcs]);
+      maxError = std::max (maxError, error);
+    }
+  double error = BuildBlerTable (PscchAwgnSisoBlerCurveXaxis[0], PscchAwgnSisoBlerCurveYaxis, pscchBlerTable_);
+  return std::max (maxError, error);
+}
+
+double
+PhyPisaData::LookupPsschBler (uint16_t mcs, double sinr) const
+{
+  if (blerTableStep_ > 0 && mcs < psschBlerTables_.size ())
+    {
+      return lookupBler (psschBlerTables_[mcs], sinr);
+    }
+  return GetPsschBler (AWGN, SISO, mcs, sinr);
+}
+
+double
+PhyPisaData::LookupPscchBler (double sinr) const
+{
+  if (blerTableStep_ > 0)
+    {
+      return lookupBler (pscchBlerTable_, sinr);
+    }
+  return GetPscchBler (AWGN, SISO, sinr);
+}
+
 double
 PhyPisaData::GetBlerAnalytical(uint16_t mcs, double sinr)
 {
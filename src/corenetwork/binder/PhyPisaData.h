@@ -36,6 +36,39 @@ class PhyPisaData
     double lambdaTable_[10000][3];
     double blerCurves_[3][15][49];
     std::vector<double> channel_;
+
+    /**
+     * BLER curve sampled every blerTableStep_ dB over [minSinr, maxSinr]
+     */
+    struct BlerTable
+    {
+        double minSinr;
+        double maxSinr;
+        std::vector<double> bler;
+    };
+    // AWGN SISO PSSCH curves for the first transmission, indexed by MCS
+    std::vector<BlerTable> psschBlerTables_;
+    // AWGN SISO PSCCH curve
+    BlerTable pscchBlerTable_;
+    // sampling step (dB) of the tables, 0 if they have not been built
+    double blerTableStep_;
+    double blerTableInvStep_;
+
+    double lookupBler(const BlerTable& table, double sinr) const
+    {
+        if (sinr < table.minSinr)
+            return 1;
+        if (sinr > table.maxSinr)
+            return 0;
+        // linear interpolation between the two nearest samples
+        double position = (sinr - table.minSinr) * blerTableInvStep_;
+        unsigned int index = (unsigned int)position;
+        if (index + 1 >= table.bler.size())
+            return table.bler.back();
+        double fraction = position - index;
+        return table.bler[index] + (table.bler[index + 1] - table.bler[index]) * fraction;
+    }
+
     public:
     PhyPisaData();
     virtual ~PhyPisaData();
@@ -48,6 +81,27 @@ class PhyPisaData
     int maxChannel2(){return 1000;}
     double getChannel(unsigned int i);
 
+    /**
+     * Samples the AWGN SISO PSSCH and PSCCH BLER curves every step dB, so that LookupPsschBler
+     * and LookupPscchBler interpolate between two adjacent samples instead of searching the curves.
+     *
+     * @param step sampling step in dB, 0 keeps the interpolation of the curves
+     * @return the largest deviation from the interpolated curves, measured halfway between samples
+     */
+    double initBlerTables(double step);
+
+    /**
+     * AWGN SISO BLER of a PSSCH TB, read from the tables built by initBlerTables
+     * or computed by GetPsschBler if there are none
+     */
+    double LookupPsschBler(uint16_t mcs, double sinr) const;
+
+    /**
+     * AWGN SISO BLER of a PSCCH, read from the table built by initBlerTables
+     * or computed by GetPscchBler if there is none
+     */
+    double LookupPscchBler(double sinr) const;
+
     /**
      * List of possible channels
      */
@@ -175,6 +229,24 @@ class PhyPisaData
       */
       static double GetBlerValue (const double (*xtable)[XTABLE_SIZE], const double *ytable, const uint16_t ysize, uint16_t mcs, uint8_t harq, double sinr);
 
+     /**
+      * \brief Interpolate the BLER of a single row of a table
+      * \param *xrow The x-axis row (min SINR, max SINR, step)
+      * \param *yrow The BLER values of the row
+      * \param sinr The SINR
+      * \return The BLER value
+      */
+      static double InterpolateBler (const double *xrow, const double *yrow, double sinr);
+
+     /**
+      * \brief Sample a row of a table every blerTableStep_ dB
+      * \param *xrow The x-axis row (min SINR, max SINR, step)
+      * \param *yrow The BLER values of the row
+      * \param table The table to fill
+      * \return The largest deviation from the interpolation halfway between samples
+      */
+      double BuildBlerTable (const double *xrow, const double *yrow, BlerTable& table);
+
      /**
       * \brief Get BLER value function
       * \param *xtable Pointer to the x-axis table
@@ -0,0 +1,75 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "corenetwork/binder/PositionHistory.h"
+
+void PositionHistory::update(MacNodeId nodeId, const inet::Coord& coord)
+{
+    NodeHistory& history = getHistory(nodeId);
+
+    if (history.count > 0)
+    {
+        // position already updated for this TTI.
+        if (history.time[(history.head + history.count - 1) % HISTORY_SIZE] == NOW)
+            return;
+    }
+
+    if (readOnly_)
+        throw cRuntimeError("PositionHistory::update - position of node %d not recorded before the concurrent readers", nodeId);
+
+    if (history.count < HISTORY_SIZE)
+    {
+        unsigned int slot = (history.head + history.count) % HISTORY_SIZE;
+        history.time[slot] = NOW;
+        history.coord[slot] = coord;
+        history.count++;
+    }
+    else
+    {
+        // overwrite the oldest one
+        history.time[history.head] = NOW;
+        history.coord[history.head] = coord;
+        history.head = (history.head + 1) % HISTORY_SIZE;
+    }
+
+    history.speedTime = -1;
+}
+
+double PositionHistory::getSpeed(MacNodeId nodeId, const inet::Coord& coord)
+{
+    NodeHistory& history = getHistory(nodeId);
+
+    if (history.speedTime == NOW && history.speedCoord == coord)
+        return history.speed;
+
+    double speed = 0.0;
+
+    //compute distance traveled from last update by UE (eNodeB position is fixed)
+    //  with a single element, it refers to present, speed is 0
+    if (history.count > 1)
+    {
+        double movement = history.coord[history.head].distance(coord);
+        if (movement > 0.0)
+        {
+            double time = (NOW.dbl()) - (history.time[history.head].dbl());
+            if (time <= 0.0) // time not updated since last speed call
+                throw cRuntimeError("Multiple entries detected in position history referring to same time");
+            // compute speed
+            speed = (movement) / (time);
+        }
+    }
+
+    if (!readOnly_)
+    {
+        history.speedTime = NOW;
+        history.speedCoord = coord;
+        history.speed = speed;
+    }
+    return speed;
+}
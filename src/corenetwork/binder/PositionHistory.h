@@ -0,0 +1,98 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_POSITIONHISTORY_H_
+#define _LTE_POSITIONHISTORY_H_
+
+#include "common/LteCommon.h"
+
+/**
+ * Recent positions and speed of every node, shared by all the channel models.
+ *
+ * Each node keeps its last HISTORY_SIZE positions (one per TTI) in a fixed
+ * ring, stored in a dense array indexed by MacNodeId (UEs and eNBs in two
+ * separate ranges, since UE ids start from UE_MIN_ID). The speed is computed
+ * once per node and TTI and then shared by every receiver asking for it.
+ */
+class PositionHistory
+{
+  public:
+    // a past and a current position
+    static const unsigned int HISTORY_SIZE = 2;
+
+  protected:
+    struct NodeHistory
+    {
+        simtime_t time[HISTORY_SIZE];
+        inet::Coord coord[HISTORY_SIZE];
+        unsigned int head;      // slot of the oldest position
+        unsigned int count;
+
+        // speed computed in the current TTI, invalidated when a position is added
+        simtime_t speedTime;
+        inet::Coord speedCoord;
+        double speed;
+
+        NodeHistory()
+        {
+            head = 0;
+            count = 0;
+            speedTime = -1;
+            speed = 0.0;
+        }
+    };
+
+    std::vector<NodeHistory> enbHistory_;
+    std::vector<NodeHistory> ueHistory_;
+
+    // while set, getSpeed() does not store the computed speed (concurrent readers)
+    bool readOnly_;
+
+    NodeHistory& getHistory(MacNodeId nodeId)
+    {
+        std::vector<NodeHistory>& histories = (nodeId >= UE_MIN_ID) ? ueHistory_ : enbHistory_;
+        unsigned int index = (nodeId >= UE_MIN_ID) ? nodeId - UE_MIN_ID : nodeId;
+        if (index >= histories.size())
+        {
+            if (readOnly_)
+                throw cRuntimeError("PositionHistory - position of node %d not recorded before the concurrent readers", nodeId);
+            histories.resize(index + 1);
+        }
+        return histories[index];
+    }
+
+  public:
+    PositionHistory()
+    {
+        readOnly_ = false;
+    }
+
+    /*
+     * While read-only, getSpeed() can be called concurrently: a speed that
+     * has not been computed beforehand is returned without being cached.
+     * update() may only be called for nodes already recorded in this TTI.
+     */
+    void setReadOnly(bool readOnly)
+    {
+        readOnly_ = readOnly;
+    }
+
+    /*
+     * Records the position of a node at the current time, at most once per TTI
+     */
+    void update(MacNodeId nodeId, const inet::Coord& coord);
+
+    /*
+     * Returns the speed (m/s) of a node at the given position, computed from
+     * the oldest position in its history
+     */
+    double getSpeed(MacNodeId nodeId, const inet::Coord& coord);
+};
+
+#endif
@@ -0,0 +1,44 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "corenetwork/channelstate/ChannelStateManager.h"
+
+Define_Module(ChannelStateManager);
+
+void ChannelStateManager::initialize()
+{
+    WATCH(views_);
+}
+
+ChannelState* ChannelStateManager::attach()
+{
+    // channel models may be built before this module is initialized
+    if (!seeded_)
+    {
+        state_.linkSeed = ((uint64_t)getRNG(0)->intRand() << 32) | getRNG(0)->intRand();
+        seeded_ = true;
+    }
+    views_++;
+    return &state_;
+}
+
+void ChannelStateManager::handleMessage(cMessage *msg)
+{
+    throw cRuntimeError("ChannelStateManager::handleMessage - this module does not process messages");
+}
+
+void ChannelStateManager::finish()
+{
+    recordScalar("channelStateViews", views_);
+}
+
+ChannelStateManager* getChannelStateManager()
+{
+    return dynamic_cast<ChannelStateManager*>(getSimulation()->getModuleByPath("channelStateManager"));
+}
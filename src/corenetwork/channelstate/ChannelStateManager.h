@@ -0,0 +1,59 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_CHANNELSTATEMANAGER_H_
+#define _LTE_CHANNELSTATEMANAGER_H_
+
+#include <omnetpp.h>
+#include "common/LteCommon.h"
+#include "stack/phy/ChannelModel/ChannelState.h"
+
+/**
+ * Owns the channel state shared by the channel models of all the nodes.
+ *
+ * Channel models look the manager up at construction (getChannelStateManager())
+ * and fall back to a private state when it is not in the network.
+ */
+class ChannelStateManager : public cSimpleModule
+{
+  protected:
+    ChannelState state_;
+
+    // number of channel models referring to the shared state
+    unsigned int views_;
+    bool seeded_;
+
+    virtual void initialize();
+    virtual void handleMessage(cMessage *msg);
+    virtual void finish();
+
+  public:
+    ChannelStateManager()
+    {
+        views_ = 0;
+        seeded_ = false;
+    }
+
+    /**
+     * Registers a channel model and returns the shared state
+     */
+    ChannelState* attach();
+
+    bool getShareJakesFading()
+    {
+        return par("shareJakesFading").boolValue();
+    }
+};
+
+/**
+ * Returns the channel state manager of the network, NULL if there is none
+ */
+ChannelStateManager* getChannelStateManager();
+
+#endif
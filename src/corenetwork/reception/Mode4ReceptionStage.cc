@@ -0,0 +1,109 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include <algorithm>
+#include "corenetwork/reception/Mode4ReceptionStage.h"
+#include "corenetwork/binder/LteBinder.h"
+#include "stack/phy/layer/LtePhyVUeMode4.h"
+
+Define_Module(Mode4ReceptionStage);
+
+Mode4ReceptionStage::Mode4ReceptionStage()
+{
+    binder_ = NULL;
+    pool_ = NULL;
+    seed_ = 0;
+    stageTimer_ = NULL;
+    batches_ = 0;
+    measuredReceivers_ = 0;
+}
+
+Mode4ReceptionStage::~Mode4ReceptionStage()
+{
+    cancelAndDelete(stageTimer_);
+    delete pool_;
+}
+
+void Mode4ReceptionStage::initialize()
+{
+    binder_ = getBinder();
+
+    int numThreads = par("numThreads");
+    if (numThreads < 0)
+        throw cRuntimeError("Mode4ReceptionStage::initialize - numThreads must not be negative, got %d", numThreads);
+    // logging is not thread safe
+    if (getEnvir()->isLoggingEnabled() && numThreads != 1)
+    {
+        EV_WARN << "Mode4ReceptionStage::initialize - logging is enabled, evaluating the receptions on a single thread" << endl;
+        numThreads = 1;
+    }
+    pool_ = new ThreadPool(numThreads);
+
+    seed_ = ((uint64_t)getRNG(0)->intRand() << 32) | getRNG(0)->intRand();
+
+    stageTimer_ = new cMessage("receptionStage");
+    // after the airframes of the TTI arrived, before the PHYs decode them (d2dDecodingTimer)
+    stageTimer_->setSchedulingPriority(9);
+}
+
+void Mode4ReceptionStage::addReceiver(LtePhyVUeMode4* phy)
+{
+    receivers_.push_back(phy);
+    if (!stageTimer_->isScheduled())
+        scheduleAt(NOW, stageTimer_);
+}
+
+void Mode4ReceptionStage::removeReceiver(LtePhyVUeMode4* phy)
+{
+    std::vector<LtePhyVUeMode4*>::iterator it = std::find(receivers_.begin(), receivers_.end(), phy);
+    if (it != receivers_.end())
+        receivers_.erase(it);
+}
+
+void Mode4ReceptionStage::handleMessage(cMessage *msg)
+{
+    if (msg != stageTimer_)
+        throw cRuntimeError("Mode4ReceptionStage::handleMessage - unexpected message %s", msg->getName());
+
+    // the channel models record the position and compute the speed of the interferers of the
+    // previous TTI and of the transmitters of the queued frames: do it now, so that the workers
+    // only read the position history (speed included)
+    const std::vector<ActiveTransmitter>& transmitters = binder_->getActiveTransmitters(NOW - TTI);
+    std::vector<ActiveTransmitter>::const_iterator it = transmitters.begin(), et = transmitters.end();
+    for (; it != et; ++it)
+    {
+        binder_->positionHistory.update(it->id, it->coord);
+        binder_->positionHistory.getSpeed(it->id, it->coord);
+    }
+    for (unsigned int i = 0; i < receivers_.size(); i++)
+        receivers_[i]->prepareReceptions();
+    // the workers look the interferers up in the spatial index, which is built on demand
+    binder_->indexActiveTransmitters(NOW - TTI);
+
+    binder_->positionHistory.setReadOnly(true);
+    pool_->parallelFor(receivers_.size(), [this](unsigned int i) {
+        receivers_[i]->measureReceptions();
+    });
+    binder_->positionHistory.setReadOnly(false);
+
+    batches_++;
+    measuredReceivers_ += receivers_.size();
+    receivers_.clear();
+}
+
+void Mode4ReceptionStage::finish()
+{
+    recordScalar("receptionStageThreads", pool_->getNumThreads());
+    recordScalar("receptionStageReceiversPerTti", batches_ > 0 ? (double)measuredReceivers_ / batches_ : 0.0);
+}
+
+Mode4ReceptionStage* getMode4ReceptionStage()
+{
+    return dynamic_cast<Mode4ReceptionStage*>(getSimulation()->getModuleByPath("receptionStage"));
+}
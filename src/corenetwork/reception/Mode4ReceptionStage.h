@@ -0,0 +1,74 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_MODE4RECEPTIONSTAGE_H_
+#define _LTE_MODE4RECEPTIONSTAGE_H_
+
+#include <omnetpp.h>
+#include "common/LteCommon.h"
+#include "common/ThreadPool.h"
+
+class LteBinder;
+class LtePhyVUeMode4;
+
+/**
+ * Per-TTI stage measuring the sidelink receptions of all the Mode 4 PHYs.
+ *
+ * PHYs register themselves when they queue the first frame of a TTI. The
+ * stage then runs once in that TTI, after all the frames have arrived and
+ * before the PHYs decode them, and evaluates the receivers on a thread pool.
+ * State shared by the channel models (position history) is brought up to
+ * date beforehand, so that the workers only read it.
+ */
+class Mode4ReceptionStage : public cSimpleModule
+{
+  protected:
+    LteBinder* binder_;
+    ThreadPool* pool_;
+
+    // seed of the per-receiver random streams
+    uint64_t seed_;
+
+    // receivers with frames queued in this TTI
+    std::vector<LtePhyVUeMode4*> receivers_;
+    cMessage* stageTimer_;
+
+    unsigned long batches_;
+    unsigned long measuredReceivers_;
+
+    virtual void initialize();
+    virtual void handleMessage(cMessage *msg);
+    virtual void finish();
+
+  public:
+    Mode4ReceptionStage();
+    virtual ~Mode4ReceptionStage();
+
+    uint64_t getSeed() const
+    {
+        return seed_;
+    }
+
+    /**
+     * Queues a receiver for the current TTI
+     */
+    void addReceiver(LtePhyVUeMode4* phy);
+
+    /**
+     * Removes a receiver being deleted before the stage ran
+     */
+    void removeReceiver(LtePhyVUeMode4* phy);
+};
+
+/**
+ * Returns the reception stage of the network, NULL if there is none
+ */
+Mode4ReceptionStage* getMode4ReceptionStage();
+
+#endif
@@ -0,0 +1,85 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_CHANNELOCCUPANCYHISTORY_H_
+#define _LTE_CHANNELOCCUPANCYHISTORY_H_
+
+#include <vector>
+#include "common/LteCommon.h"
+
+/**
+ * Subchannels used by the past transmissions of a Mode 4 UE, over the last
+ * 1000 subframes (the CR evaluation window).
+ *
+ * The history is a ring of running totals: slot (s % 1000) holds the number
+ * of subchannels used up to and including subframe s, so the subchannels
+ * used in any span of the window are the difference of two slots. Subframes
+ * without transmissions are filled in when time moves on, which costs one
+ * slot per elapsed subframe whatever the number of transmissions.
+ */
+class ChannelOccupancyHistory
+{
+    public:
+        static const int WINDOW_LENGTH = 1000;
+
+    protected:
+        std::vector<long> cumulative;
+        // latest subframe whose slot is up to date
+        long lastSubframe;
+        long total;
+
+        void advance(long subframe)
+        {
+            if (subframe <= lastSubframe)
+                return;
+            long first = lastSubframe + 1;
+            if (first < subframe - WINDOW_LENGTH + 1)
+                first = subframe - WINDOW_LENGTH + 1;
+            for (long s = first; s <= subframe; s++)
+                cumulative[s % WINDOW_LENGTH] = total;
+            lastSubframe = subframe;
+        }
+
+    public:
+        ChannelOccupancyHistory() :
+            cumulative(WINDOW_LENGTH, 0), lastSubframe(-1), total(0)
+        {
+        }
+
+        static long getSubframe(simtime_t time)
+        {
+            return (long)floor(time.dbl() / TTI + 0.5);
+        }
+
+        /**
+         * Records a transmission over the given number of subchannels.
+         */
+        void addTransmission(simtime_t time, int subchannels)
+        {
+            long subframe = getSubframe(time);
+            advance(subframe);
+            total += subchannels;
+            cumulative[subframe % WINDOW_LENGTH] = total;
+        }
+
+        /**
+         * Subchannels used in the last numSubframes subframes, the one of the
+         * given time included (numSubframes < WINDOW_LENGTH).
+         */
+        long getSubchannelsUsed(simtime_t time, int numSubframes)
+        {
+            long subframe = getSubframe(time);
+            advance(subframe);
+            long start = subframe - numSubframes;
+            long before = (start < 0) ? 0 : cumulative[start % WINDOW_LENGTH];
+            return total - before;
+        }
+};
+
+#endif
@@ -35,16 +35,20 @@
 #include "inet/networklayer/ipv4/IPv4InterfaceData.h"
 #include "stack/mac/amc/LteMcs.h"
 #include <map>
+#include <algorithm>
 
 Define_Module(LteMacVUeMode4);
 
 LteMacVUeMode4::LteMacVUeMode4() :
     LteMacUeRealisticD2D()
 {
+    flushHarqMsg_ = NULL;
+    harqRxPending_ = false;
 }
 
 LteMacVUeMode4::~LteMacVUeMode4()
 {
+    cancelAndDelete(flushHarqMsg_);
 }
 
 void LteMacVUeMode4::initialize(int stage)
@@ -54,10 +58,22 @@ void LteMacVUeMode4::initialize(int stage)
 
     if (stage == inet::INITSTAGE_LOCAL)
     {
-        parseUeTxConfig(par("txConfig").xmlValue());
-        parseCbrTxConfig(par("txConfig").xmlValue());
-        parseRriConfig(par("txConfig").xmlValue());
-        resourceReservationInterval_ = validResourceReservationIntervals_.at(0);
+        SidelinkConfiguration::Defaults defaults;
+        defaults.minMcs = par("minMCSPSSCH");
+        defaults.maxMcs = par("maxMCSPSSCH");
+        defaults.minSubchannels = par("minSubchannelNumberPSSCH");
+        defaults.maxSubchannels = par("maxSubchannelNumberPSSCH");
+        defaults.allowedRetx = par("allowedRetxNumberPSSCH");
+        txConfig_ = SidelinkConfiguration::get(par("txConfig").xmlValue(), defaults);
+
+        const SidelinkTxParameters& ueTxParameters = txConfig_->getUeTxParameters();
+        minMCSPSSCH_ = ueTxParameters.minMcs;
+        maxMCSPSSCH_ = ueTxParameters.maxMcs;
+        minSubchannelNumberPSSCH_ = ueTxParameters.minSubchannels;
+        maxSubchannelNumberPSSCH_ = ueTxParameters.maxSubchannels;
+        allowedRetxNumberPSSCH_ = ueTxParameters.allowedRetx;
+        defaultCbrIndex_ = txConfig_->getDefaultCbrIndex();
+        resourceReservationInterval_ = txConfig_->getValidRris().at(0);
         subchannelSize_ = par("subchannelSize");
         numSubchannels_ = par("numSubchannels");
         probResourceKeep_ = par("probResourceKeep");
@@ -76,6 +92,12 @@ void LteMacVUeMode4::initialize(int stage)
 
         currentCbrIndex_ = defaultCbrIndex_;
 
+        // Message that triggers flushing of Tx H-ARQ buffers, reused at every transmission
+        flushHarqMsg_ = new cMessage("flushHarqMsg");
+        flushHarqMsg_->setSchedulingPriority(1);        // after other messages
+
+        buildTbCapacityTables();
+
         // Register the necessary signals for this simulation
 
         grantStartTime          = registerSignal("grantStartTime");
@@ -127,208 +149,6 @@ void LteMacVUeMode4::initialize(int stage)
     }
 }
 
-void LteMacVUeMode4::parseUeTxConfig(cXMLElement* xmlConfig)
-{
-    if (xmlConfig == 0)
-    throw cRuntimeError("No sidelink configuration file specified");
-
-    // Get channel Model field which contains parameters fields
-    cXMLElementList ueTxConfig = xmlConfig->getElementsByTagName("userEquipment-txParameters");
-
-    if (ueTxConfig.empty())
-        throw cRuntimeError("No userEquipment-txParameters configuration found in configuration file");
-
-    if (ueTxConfig.size() > 1)
-        throw cRuntimeError("More than one userEquipment-txParameters configuration found in configuration file.");
-
-    cXMLElement* ueTxConfigData = ueTxConfig.front();
-
-    ParameterMap params;
-    getParametersFromXML(ueTxConfigData, params);
-
-    //get lambda max threshold
-    ParameterMap::iterator it = params.find("minMCS-PSSCH");
-    if (it != params.end())
-    {
-        minMCSPSSCH_ = (int)it->second;
-    }
-    else
-        minMCSPSSCH_ = (int)par("minMCSPSSCH");
-    it = params.find("maxMCS-PSSCH");
-    if (it != params.end())
-    {
-        maxMCSPSSCH_ = (int)it->second;
-    }
-    else
-        maxMCSPSSCH_ = (int)par("minMCSPSSCH");
-    it = params.find("minSubchannel-NumberPSSCH");
-    if (it != params.end())
-    {
-        minSubchannelNumberPSSCH_ = (int)it->second;
-    }
-    else
-        minSubchannelNumberPSSCH_ = (int)par("minSubchannelNumberPSSCH");
-    it = params.find("maxSubchannel-NumberPSSCH");
-    if (it != params.end())
-    {
-        maxSubchannelNumberPSSCH_ = (int)it->second;
-    }
-    else
-        maxSubchannelNumberPSSCH_ = (int)par("maxSubchannelNumberPSSCH");
-    it = params.find("allowedRetxNumberPSSCH");
-    if (it != params.end())
-    {
-        allowedRetxNumberPSSCH_ = (int)it->second;
-    }
-    else
-        allowedRetxNumberPSSCH_ = (int)par("allowedRetxNumberPSSCH");
-}
-
-void LteMacVUeMode4::parseCbrTxConfig(cXMLElement* xmlConfig)
-{
-    if (xmlConfig == 0)
-    throw cRuntimeError("No cbr configuration specified");
-
-    // Get channel Model field which contains parameters fields
-    cXMLElementList cbrTxConfig = xmlConfig->getElementsByTagName("Sl-CBR-CommonTxConfigList");
-
-    if (cbrTxConfig.empty())
-        throw cRuntimeError("No Sl-CBR-CommonTxConfigList found in configuration file");
-
-    cXMLElement* cbrTxConfigData = cbrTxConfig.front();
-
-    ParameterMap params;
-    getParametersFromXML(cbrTxConfigData, params);
-
-    //get lambda max threshold
-    ParameterMap::iterator it = params.find("default-cbr-ConfigIndex");
-    if (it != params.end())
-    {
-        defaultCbrIndex_ = it->second;
-        currentCbrIndex_ = defaultCbrIndex_;
-    }
-
-    cXMLElementList cbrLevelConfigs = xmlConfig->getElementsByTagName("cbr-ConfigIndex");
-
-    if (cbrLevelConfigs.empty())
-        throw cRuntimeError("No cbr-Levels-Config found in configuration file");
-
-    cXMLElementList::iterator xmlIt;
-    for(xmlIt = cbrLevelConfigs.begin(); xmlIt != cbrLevelConfigs.end(); xmlIt++)
-    {
-        std::unordered_map<std::string, double> cbrLevelsMap;
-        ParameterMap cbrLevelsParams;
-        getParametersFromXML((*xmlIt), cbrLevelsParams);
-        it = cbrLevelsParams.find("cbr-lower");
-        if (it != cbrLevelsParams.end())
-        {
-            cbrLevelsMap.insert(pair<std::string, double>("cbr-lower",  it->second));
-        }
-        it = cbrLevelsParams.find("cbr-upper");
-        if (it != cbrLevelsParams.end())
-        {
-            cbrLevelsMap.insert(pair<std::string, double>("cbr-upper",  it->second));
-        }
-        it = cbrLevelsParams.find("cbr-PSSCH-TxConfig-Index");
-        if (it != cbrLevelsParams.end())
-        {
-            cbrLevelsMap.insert(pair<std::string, double>("cbr-PSSCH-TxConfig-Index",  it->second));
-        }
-        cbrLevels_.push_back(cbrLevelsMap);
-    }
-
-    cXMLElementList cbrTxConfigs = xmlConfig->getElementsByTagName("cbr-PSSCH-TxConfig");
-
-    if (cbrTxConfigs.empty())
-        throw cRuntimeError("No CBR-TxConfig found in configuration file");
-
-    cXMLElementList cbrTxParams = xmlConfig->getElementsByTagName("txParameters");
-
-    for(xmlIt = cbrTxParams.begin(); xmlIt != cbrTxParams.end(); xmlIt++)
-    {
-        std::unordered_map<std::string, double> cbrMap;
-        ParameterMap cbrParams;
-        getParametersFromXML((*xmlIt), cbrParams);
-        it = cbrParams.find("minMCS-PSSCH");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"minMCS-PSSCH",  it->second});
-        }
-        else
-            cbrMap.insert({"minMCS-PSSCH",  par("minMCSPSSCH")});
-        it = cbrParams.find("maxMCS-PSSCH");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"maxMCS-PSSCH",  it->second});
-        }
-        else
-            cbrMap.insert({"maxMCS-PSSCH",  par("maxMCSPSSCH")});
-        it = cbrParams.find("minSubchannel-NumberPSSCH");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"minSubchannel-NumberPSSCH",  it->second});
-        }
-        else
-            cbrMap.insert({"minSubchannel-NumberPSSCH",  par("minSubchannelNumberPSSCH")});
-        it = cbrParams.find("maxSubchannel-NumberPSSCH");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"maxSubchannel-NumberPSSCH",  it->second});
-        }
-        else
-            cbrMap.insert({"maxSubchannel-NumberPSSCH",  par("maxSubchannelNumberPSSCH")});
-        it = cbrParams.find("allowedRetxNumberPSSCH");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"allowedRetxNumberPSSCH",  it->second});
-        }
-        else
-            cbrMap.insert({"allowedRetxNumberPSSCH",  par("allowedRetxNumberPSSCH")});
-        it = cbrParams.find("allowedRRI");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"allowedRRI",  it->second});
-        }
-        else
-            cbrMap.insert({"allowedRRI",  resourceReservationInterval_});
-        it = cbrParams.find("cr-Limit");
-        if (it != cbrParams.end())
-        {
-            cbrMap.insert({"cr-Limit",  it->second});
-        }
-        cbrPSSCHTxConfigList_.push_back(cbrMap);
-    }
-}
-
-void LteMacVUeMode4::parseRriConfig(cXMLElement* xmlConfig)
-{
-    if (xmlConfig == 0)
-    throw cRuntimeError("No cbr configuration specified");
-
-    // Get channel Model field which contains parameters fields
-    cXMLElementList rriConfig = xmlConfig->getElementsByTagName("RestrictResourceReservationPeriodList");
-
-    if (rriConfig.empty())
-        throw cRuntimeError("No RestrictResourceReservationPeriodList found in configuration file");
-
-    cXMLElementList rriConfigs = xmlConfig->getElementsByTagName("RestrictResourceReservationPeriod");
-
-    if (rriConfigs.empty())
-        throw cRuntimeError("No RestrictResourceReservationPeriods found in configuration file");
-
-    cXMLElementList::iterator xmlIt;
-    for(xmlIt = rriConfigs.begin(); xmlIt != rriConfigs.end(); xmlIt++)
-    {
-        ParameterMap rriParams;
-        getParametersFromXML((*xmlIt), rriParams);
-        ParameterMap::iterator it = rriParams.find("rri");
-        if (it != rriParams.end())
-        {
-            validResourceReservationIntervals_.push_back(it->second);
-        }
-    }
-}
-
 int LteMacVUeMode4::getNumAntennas()
 {
     /* Get number of antennas: +1 is for MACRO */
@@ -535,27 +355,122 @@ double LteMacVUeMode4::calculateChannelOccupancyRatio(int period){
     // determine a
     a = 999 - b;
 
-    // determine previous transmissions -> Need to account for if we have already done a drop. Must maintain a
-    // history of past transmissions i.e. subchannels used and subframe in which they occur. delete entries older
-    // than 1000.
-    std::unordered_map<double, int>::const_iterator it = previousTransmissions_.begin();
-    while (it != previousTransmissions_.end()){
-        if (it->first < NOW.dbl() - 1){
-            it = previousTransmissions_.erase(it);
-            continue;
-        } else if (it->first > NOW.dbl() - (0.001 * a)) {
-            subchannelsUsed += it->second;
-        }
-        it++;
-    }
+    // determine previous transmissions, i.e. the subchannels used in the last a subframes
+    subchannelsUsed += previousTransmissions_.getSubchannelsUsed(NOW, a);
     // calculate cr
     return subchannelsUsed /(numSubchannels_ * 1000.0);
 }
 
+void LteMacVUeMode4::getGrantSearchRange(int cbrIndex, int& minSubchannels, int& maxSubchannels, int& minMcs, int& maxMcs)
+{
+    minSubchannels = minSubchannelNumberPSSCH_;
+    maxSubchannels = maxSubchannelNumberPSSCH_;
+    minMcs = minMCSPSSCH_;
+    maxMcs = maxMCSPSSCH_;
+
+    if (cbrIndex < 0)
+        return;
+
+    const SidelinkTxParameters& cbrTxConfig = txConfig_->getCbrTxConfig(cbrIndex);
+    int cbrMinSubchannelNum = cbrTxConfig.minSubchannels;
+    int cbrMaxSubchannelNum = cbrTxConfig.maxSubchannels;
+    int cbrMinMCS = cbrTxConfig.minMcs;
+    int cbrMaxMCS = cbrTxConfig.maxMcs;
+
+    if (maxSubchannelNumberPSSCH_ < cbrMinSubchannelNum || cbrMaxSubchannelNum < minSubchannelNumberPSSCH_)
+    {
+        // No overlap therefore I will use the cbr values (this is left to the UE, the opposite approach is also entirely valid).
+        minSubchannels = cbrMinSubchannelNum;
+        maxSubchannels = cbrMaxSubchannelNum;
+    }
+    else
+    {
+        minSubchannels = max(minSubchannelNumberPSSCH_, cbrMinSubchannelNum);
+        maxSubchannels = min(maxSubchannelNumberPSSCH_, cbrMaxSubchannelNum);
+    }
+
+    if (maxMCSPSSCH_ < cbrMinMCS || cbrMaxMCS < minMCSPSSCH_) {
+        // No overlap therefore I will use the cbr values (this is left to the UE).
+        minMcs = cbrMinMCS;
+        maxMcs = cbrMaxMCS;
+    } else {
+        minMcs = max(minMCSPSSCH_, cbrMinMCS);
+        maxMcs = min(maxMCSPSSCH_, cbrMaxMCS);
+    }
+}
+
+void LteMacVUeMode4::buildTbCapacityTables()
+{
+    // The modulation (hence the TBS table) follows the maximum configured MCS, whatever the MCS used
+    LteMod mod = _QPSK;
+    int numItbs = 10;
+    if (maxMCSPSSCH_ > 9 && maxMCSPSSCH_ < 17)
+    {
+        mod = _16QAM;
+        numItbs = 7;
+    }
+    else if (maxMCSPSSCH_ > 16 && maxMCSPSSCH_ < 29 )
+    {
+        mod = _64QAM;
+        numItbs = 12;
+    }
+    int firstItbs = (mod == _QPSK ? 0 : (mod == _16QAM ? 9 : 15));
+
+    // cover the RBs of the resource pool and of the largest grant any configuration may ask for
+    int numCbrConfigs = txConfig_->getCbrTxConfigs().size();
+    std::vector<int> minSubchannels(numCbrConfigs + 1), maxSubchannels(numCbrConfigs + 1);
+    std::vector<int> minMcs(numCbrConfigs + 1), maxMcs(numCbrConfigs + 1);
+    int maxGrantSubchannels = numSubchannels_;
+    for (int cbrIndex = -1; cbrIndex < numCbrConfigs; cbrIndex++)
+    {
+        int k = cbrIndex + 1;
+        getGrantSearchRange(cbrIndex, minSubchannels[k], maxSubchannels[k], minMcs[k], maxMcs[k]);
+        maxGrantSubchannels = max(maxGrantSubchannels, maxSubchannels[k]);
+    }
+
+    tbCapacityTableRbs_ = min(maxGrantSubchannels * subchannelSize_, 110);
+    tbCapacityTable_.assign(tbCapacityTableRbs_ * NUM_PSSCH_MCS, 0);
+    for (int mcs = firstItbs; mcs < firstItbs + numItbs && mcs < NUM_PSSCH_MCS; mcs++)
+    {
+        const unsigned int* tbsVect = itbs2tbs(mod, SINGLE_ANTENNA_PORT0, 1, mcs - firstItbs);
+        for (int rbs = 1; rbs <= tbCapacityTableRbs_; rbs++)
+            tbCapacityTable_[(rbs - 1) * NUM_PSSCH_MCS + mcs] = tbsVect[rbs - 1];
+    }
+
+    grantConfigs_.assign(numCbrConfigs + 1, std::vector<GrantConfig>());
+    grantConfigCapacity_.assign(numCbrConfigs + 1, std::vector<unsigned int>());
+    for (int k = 0; k <= numCbrConfigs; k++)
+    {
+        std::vector<GrantConfig>& configs = grantConfigs_[k];
+        std::vector<unsigned int>& capacity = grantConfigCapacity_[k];
+        unsigned int maxCapacity = 0;
+        for (int i = minSubchannels[k]; i <= maxSubchannels[k]; i++)
+        {
+            int totalGrantedBlocks = (i * subchannelSize_);
+            if (adjacencyPSCCHPSSCH_) {
+                totalGrantedBlocks -= 2; // 2 RBs for the sci in adjacent mode
+            }
+            for (int mcs = minMcs[k]; mcs <= maxMcs[k]; mcs++)
+            {
+                GrantConfig config = {i, mcs};
+                maxCapacity = max(maxCapacity, getTbCapacity(totalGrantedBlocks, mcs));
+                configs.push_back(config);
+                capacity.push_back(maxCapacity);
+            }
+        }
+    }
+}
+
 void LteMacVUeMode4::handleMessage(cMessage *msg)
 {
     if (msg->isSelfMessage())
     {
+        if (msg == flushHarqMsg_)
+        {
+            // reused every TTI, so it must not reach the base class which deletes it
+            flushHarqBuffers();
+            return;
+        }
         LteMacUeRealisticD2D::handleMessage(msg);
         return;
     }
@@ -584,28 +499,28 @@ void LteMacVUeMode4::handleMessage(cMessage *msg)
             cbr_ = cbrPkt->getCbr();
 
             if (useCBR_) {
-                std::vector<std::unordered_map<std::string, double>>::iterator it;
-                for (it = cbrLevels_.begin(); it!=cbrLevels_.end(); it++)
+                std::vector<SidelinkCbrLevel>::const_iterator it;
+                for (it = txConfig_->getCbrLevels().begin(); it != txConfig_->getCbrLevels().end(); it++)
                 {
-                    double cbrUpper = (*it).at("cbr-upper");
-                    double cbrLower = (*it).at("cbr-lower");
-                    double index = (*it).at("cbr-PSSCH-TxConfig-Index");
+                    double cbrUpper = it->cbrUpper;
+                    double cbrLower = it->cbrLower;
+                    int index = it->txConfigIndex;
                     if (cbrLower == 0){
                         if (cbr_< cbrUpper)
                         {
-                            currentCbrIndex_ = (int)index;
+                            currentCbrIndex_ = index;
                             break;
                         }
                     } else if (cbrUpper == 1){
                         if (cbr_ > cbrLower)
                         {
-                            currentCbrIndex_ = (int)index;
+                            currentCbrIndex_ = index;
                             break;
                         }
                     } else {
                         if (cbr_ > cbrLower && cbr_<= cbrUpper)
                         {
-                            currentCbrIndex_ = (int)index;
+                            currentCbrIndex_ = index;
                             break;
                         }
                     }
@@ -625,6 +540,8 @@ void LteMacVUeMode4::handleMessage(cMessage *msg)
 
             return;
         }
+        // anything else from the PHY may fill the H-ARQ rx buffers
+        harqRxPending_ = true;
     }
     else if (incoming == up_[IN])
     {
@@ -669,30 +586,44 @@ void LteMacVUeMode4::handleSelfMessage()
 {
     EV << "----- UE MAIN LOOP -----" << endl;
 
-    // extract pdus from all harqrxbuffers and pass them to unmaker
-    HarqRxBuffers::iterator hit = harqRxBuffers_.begin();
-    HarqRxBuffers::iterator het = harqRxBuffers_.end();
-    LteMacPdu *pdu = NULL;
-    std::list<LteMacPdu*> pduList;
+    // Idle TTI: nothing received, no grant and nothing buffered, only the HARQ process moves on
+    if (!harqRxPending_ && schedulingGrant_ == NULL && macBuffersEmpty())
+    {
+        currentHarq_ = (currentHarq_+1) % harqProcesses_;
+        return;
+    }
 
-    for (; hit != het; ++hit)
+    if (harqRxPending_)
     {
-        pduList=hit->second->extractCorrectPdus();
-        while (! pduList.empty())
+        // extract pdus from all harqrxbuffers and pass them to unmaker
+        HarqRxBuffers::iterator hit = harqRxBuffers_.begin();
+        HarqRxBuffers::iterator het = harqRxBuffers_.end();
+        LteMacPdu *pdu = NULL;
+        std::list<LteMacPdu*> pduList;
+
+        for (; hit != het; ++hit)
         {
-            pdu=pduList.front();
-            pduList.pop_front();
-            macPduUnmake(pdu);
+            pduList=hit->second->extractCorrectPdus();
+            while (! pduList.empty())
+            {
+                pdu=pduList.front();
+                pduList.pop_front();
+                macPduUnmake(pdu);
+            }
         }
-    }
 
-    unsigned int purged =0;
-    // purge from corrupted PDUs all Rx H-HARQ buffers
-    for (hit= harqRxBuffers_.begin(); hit != het; ++hit)
-    {
-        purged += hit->second->purgeCorruptedPdus();
+        unsigned int purged =0;
+        // purge from corrupted PDUs all Rx H-HARQ buffers
+        for (hit= harqRxBuffers_.begin(); hit != het; ++hit)
+        {
+            purged += hit->second->purgeCorruptedPdus();
+        }
+        EV << NOW << " LteMacVUeMode4::handleSelfMessage Purged " << purged << " PDUS" << endl;
+
+        // Mode 4 rx processes are decided on insertion (no EVALUATING state),
+        // so after extraction and purge all rx buffers are empty
+        harqRxPending_ = false;
     }
-    EV << NOW << " LteMacVUeMode4::handleSelfMessage Purged " << purged << " PDUS" << endl;
 
     EV << NOW << "LteMacVUeMode4::handleSelfMessage " << nodeId_ << " - HARQ process " << (unsigned int)currentHarq_ << endl;
     // updating current HARQ process for next TTI
@@ -827,28 +758,30 @@ void LteMacVUeMode4::handleSelfMessage()
         }
         // Message that triggers flushing of Tx H-ARQ buffers for all users
         // This way, flushing is performed after the (possible) reception of new MAC PDUs
-        cMessage* flushHarqMsg = new cMessage("flushHarqMsg");
-        flushHarqMsg->setSchedulingPriority(1);        // after other messages
-        scheduleAt(NOW, flushHarqMsg);
+        if (!flushHarqMsg_->isScheduled())
+            scheduleAt(NOW, flushHarqMsg_);
     }
     //============================ DEBUG ==========================
-    HarqTxBuffers::iterator it;
-
-    EV << "\n htxbuf.size " << harqTxBuffers_.size() << endl;
-
-    int cntOuter = 0;
-    int cntInner = 0;
-    for(it = harqTxBuffers_.begin(); it != harqTxBuffers_.end(); it++)
+    if (getEnvir()->isLoggingEnabled())
     {
-        LteHarqBufferTx* currHarq = it->second;
-        BufferStatus harqStatus = currHarq->getBufferStatus();
-        BufferStatus::iterator jt = harqStatus.begin(), jet= harqStatus.end();
+        HarqTxBuffers::iterator it;
+
+        EV << "\n htxbuf.size " << harqTxBuffers_.size() << endl;
 
-        EV_DEBUG << "\t cicloOuter " << cntOuter << " - bufferStatus.size=" << harqStatus.size() << endl;
-        for(; jt != jet; ++jt)
+        int cntOuter = 0;
+        int cntInner = 0;
+        for(it = harqTxBuffers_.begin(); it != harqTxBuffers_.end(); it++)
         {
-            EV_DEBUG << "\t\t cicloInner " << cntInner << " - jt->size=" << jt->size()
-               << " - statusCw(0/1)=" << jt->at(0).second << "/" << jt->at(1).second << endl;
+            LteHarqBufferTx* currHarq = it->second;
+            BufferStatus harqStatus = currHarq->getBufferStatus();
+            BufferStatus::iterator jt = harqStatus.begin(), jet= harqStatus.end();
+
+            EV_DEBUG << "\t cicloOuter " << cntOuter << " - bufferStatus.size=" << harqStatus.size() << endl;
+            for(; jt != jet; ++jt)
+            {
+                EV_DEBUG << "\t\t cicloInner " << cntInner << " - jt->size=" << jt->size()
+                   << " - statusCw(0/1)=" << jt->at(0).second << "/" << jt->at(1).second << endl;
+            }
         }
     }
     //======================== END DEBUG ==========================
@@ -862,6 +795,17 @@ void LteMacVUeMode4::handleSelfMessage()
     EV << "--- END UE MAIN LOOP ---" << endl;
 }
 
+bool LteMacVUeMode4::macBuffersEmpty() const
+{
+    LteMacBufferMap::const_iterator it;
+    for (it = macBuffers_.begin(); it != macBuffers_.end(); ++it)
+    {
+        if (!it->second->isEmpty())
+            return false;
+    }
+    return true;
+}
+
 void LteMacVUeMode4::macHandleSps(cPacket* pkt)
 {
     /**   This is where we add the subchannels to the actual scheduling grant, so a few things
@@ -934,20 +878,7 @@ void LteMacVUeMode4::macHandleSps(cPacket* pkt)
     mode4Grant->setStartingSubchannel(initiailSubchannel);
     mode4Grant->setMcs(maxMCSPSSCH_);
 
-    LteMod mod = _QPSK;
-    if (maxMCSPSSCH_ > 9 && maxMCSPSSCH_ < 17)
-    {
-        mod = _16QAM;
-    }
-    else if (maxMCSPSSCH_ > 16 && maxMCSPSSCH_ < 29 )
-    {
-        mod = _64QAM;
-    }
-
-    unsigned int i = (mod == _QPSK ? 0 : (mod == _16QAM ? 9 : (mod == _64QAM ? 15 : 0)));
-
-    const unsigned int* tbsVect = itbs2tbs(mod, SINGLE_ANTENNA_PORT0, 1, maxMCSPSSCH_ - i);
-    maximumCapacity_ = tbsVect[totalGrantedBlocks-1];
+    maximumCapacity_ = getTbCapacity(totalGrantedBlocks, maxMCSPSSCH_);
     mode4Grant->setGrantedCwBytes(currentCw_, maximumCapacity_);
     // Simply flips the codeword.
     currentCw_ = MAX_CODEWORDS - currentCw_;
@@ -979,114 +910,28 @@ void LteMacVUeMode4::macGenerateSchedulingGrant(double maximumLatency, int prior
     mode4Grant -> setSpsPriority(priority);
     mode4Grant -> setPeriod(resourceReservationInterval_ * 100);
     mode4Grant -> setMaximumLatency(maximumLatency);
-    mode4Grant -> setPossibleRRIs(validResourceReservationIntervals_);
+    mode4Grant -> setPossibleRRIs(txConfig_->getValidRris());
 
-    int minSubchannelNumberPSSCH = minSubchannelNumberPSSCH_;
-    int maxSubchannelNumberPSSCH = maxSubchannelNumberPSSCH_;
-    int minMCS = minMCSPSSCH_;
-    int maxMCS = maxMCSPSSCH_;
     int numSubchannels = 0;
-    bool foundValidMCS = false;
+    int cbrIndex = -1;
     double resourceReservationInterval = resourceReservationInterval_;
 
     if (useCBR_)
     {
-        int cbrMinSubchannelNum;
-        int cbrMaxSubchannelNum;
-        int cbrMinMCS;
-        int cbrMaxMCS;
-
-        std::unordered_map<std::string,double> cbrMap = cbrPSSCHTxConfigList_.at(currentCbrIndex_);
-
-        std::unordered_map<std::string,double>::const_iterator got = cbrMap.find("allowedRetxNumberPSSCH");
-        if ( got == cbrMap.end() )
-            allowedRetxNumberPSSCH_ = allowedRetxNumberPSSCH_;
-        else
-            allowedRetxNumberPSSCH_ = min((int)got->second, allowedRetxNumberPSSCH_);
+        allowedRetxNumberPSSCH_ = min(txConfig_->getCbrTxConfig(currentCbrIndex_).allowedRetx, allowedRetxNumberPSSCH_);
 
-        got = cbrMap.find("minSubchannel-NumberPSSCH");
-        if ( got == cbrMap.end() )
-            cbrMinSubchannelNum = minSubchannelNumberPSSCH_;
-        else
-            cbrMinSubchannelNum = (int)got->second;
-
-        got = cbrMap.find("maxSubchannel-NumberPSSCH");
-        if ( got == cbrMap.end() )
-            cbrMaxSubchannelNum = maxSubchannelNumberPSSCH_;
-        else
-            cbrMaxSubchannelNum = (int)got->second;
-
-        /**
-         * Need to pick the number of subchannels for this reservation
-         */
-        if (maxSubchannelNumberPSSCH_ < cbrMinSubchannelNum || cbrMaxSubchannelNum < minSubchannelNumberPSSCH_)
-        {
-            // No overlap therefore I will use the cbr values (this is left to the UE, the opposite approach is also entirely valid).
-            minSubchannelNumberPSSCH = cbrMinSubchannelNum;
-            maxSubchannelNumberPSSCH = cbrMaxSubchannelNum;
-        }
-        else
-        {
-            minSubchannelNumberPSSCH = max(minSubchannelNumberPSSCH_, cbrMinSubchannelNum);
-            maxSubchannelNumberPSSCH = min(maxSubchannelNumberPSSCH_, cbrMaxSubchannelNum);
-        }
-
-        got = cbrMap.find("minMCS-PSSCH");
-        if (got == cbrMap.end())
-            cbrMinMCS = minMCSPSSCH_;
-        else
-            cbrMinMCS = (int) got->second;
-
-        got = cbrMap.find("maxMCS-PSSCH");
-        if (got == cbrMap.end())
-            cbrMaxMCS = maxMCSPSSCH_;
-        else
-            cbrMaxMCS = (int) got->second;
-
-        if (maxMCSPSSCH_ < cbrMinMCS || cbrMaxMCS < minMCSPSSCH_) {
-            // No overlap therefore I will use the cbr values (this is left to the UE).
-            minMCS = cbrMinMCS;
-            maxMCS = cbrMaxMCS;
-        } else {
-            minMCS = max(minMCSPSSCH_, cbrMinMCS);
-            maxMCS = min(maxMCSPSSCH_, cbrMaxMCS);
-        }
+        cbrIndex = currentCbrIndex_;
     }
 
-    // Select the number of subchannels based on the size of the packet to be transmitted
-    int i = minSubchannelNumberPSSCH;
-    while (i <= maxSubchannelNumberPSSCH && !foundValidMCS){
-        int totalGrantedBlocks = (i * subchannelSize_);
-        if (adjacencyPSCCHPSSCH_) {
-            totalGrantedBlocks -= 2; // 2 RBs for the sci in adjacent mode
-        }
-
-        int mcsCapacity = 0;
-        for (int mcs=minMCS; mcs <= maxMCS; mcs++) {
-            LteMod mod = _QPSK;
-            if (maxMCSPSSCH_ > 9 && maxMCSPSSCH_ < 17) {
-                mod = _16QAM;
-            } else if (maxMCSPSSCH_ > 16 && maxMCSPSSCH_ < 29) {
-                mod = _64QAM;
-            }
-
-            unsigned int j = (mod == _QPSK ? 0 : (mod == _16QAM ? 9 : (mod == _64QAM ? 15 : 0)));
-
-            const unsigned int *tbsVect = itbs2tbs(mod, SINGLE_ANTENNA_PORT0, 1, mcs - j);
-            mcsCapacity = tbsVect[totalGrantedBlocks - 1];
-
-            if (mcsCapacity > pktSize) {
-                foundValidMCS = true;
-                numSubchannels = i;
-                break;
-            }
-        }
-        i++;
-    }
+    // Select the number of subchannels based on the size of the packet to be transmitted, i.e. the
+    // first configuration (fewest subchannels, then lowest MCS) whose capacity exceeds it
+    const std::vector<unsigned int>& capacity = grantConfigCapacity_.at(cbrIndex + 1);
+    std::vector<unsigned int>::const_iterator found = std::upper_bound(capacity.begin(), capacity.end(), (unsigned int)pktSize);
 
-    if (!foundValidMCS){
+    if (found == capacity.end()){
         throw cRuntimeError("On generating the grant there was no subchannel configuration which could hold the capacity of the packet: exiting.");
     }
+    numSubchannels = grantConfigs_[cbrIndex + 1][found - capacity.begin()].numSubchannels;
 
     mode4Grant -> setNumberSubchannels(numSubchannels);
     if (randomScheduling_){
@@ -1152,18 +997,10 @@ void LteMacVUeMode4::flushHarqBuffers()
     HarqTxBuffers::iterator it2;
     for(it2 = harqTxBuffers_.begin(); it2 != harqTxBuffers_.end(); it2++)
     {
-        std::unordered_map<std::string,double> cbrMap = cbrPSSCHTxConfigList_.at(currentCbrIndex_);
-        std::unordered_map<std::string,double>::const_iterator got;
+        const SidelinkTxParameters& cbrTxConfig = txConfig_->getCbrTxConfig(currentCbrIndex_);
 
         if (packetDropping_) {
-            double crLimit;
-            got = cbrMap.find("cr-Limit");
-            if (got == cbrMap.end())
-                crLimit = 1;
-            else
-                crLimit = got->second;
-
-            if (channelOccupancyRatio_ > crLimit) {
+            if (channelOccupancyRatio_ > cbrTxConfig.crLimit) {
                 // Need to drop the unit currently selected
                 UnitList ul = it2->second->firstAvailable();
                 it2->second->forceDropProcess(ul.first);
@@ -1182,20 +1019,8 @@ void LteMacVUeMode4::flushHarqBuffers()
                 if (pduLength > 0)
                 {
                     if (useCBR_){
-                        int cbrMinMCS;
-                        int cbrMaxMCS;
-
-                        got = cbrMap.find("minMCS-PSSCH");
-                        if ( got == cbrMap.end() )
-                            cbrMinMCS = minMCSPSSCH_;
-                        else
-                            cbrMinMCS = (int)got->second;
-
-                        got = cbrMap.find("maxMCS-PSSCH");
-                        if ( got == cbrMap.end() )
-                            cbrMaxMCS = maxMCSPSSCH_;
-                        else
-                            cbrMaxMCS = (int)got->second;
+                        int cbrMinMCS = cbrTxConfig.minMcs;
+                        int cbrMaxMCS = cbrTxConfig.maxMcs;
 
                         if (maxMCSPSSCH_ < cbrMinMCS || cbrMaxMCS < minMCSPSSCH_)
                         {
@@ -1216,20 +1041,7 @@ void LteMacVUeMode4::flushHarqBuffers()
                     int mcsCapacity = 0;
                     for (int mcs=minMCS; mcs <= maxMCS; mcs++)
                     {
-                        LteMod mod = _QPSK;
-                        if (maxMCSPSSCH_ > 9 && maxMCSPSSCH_ < 17)
-                        {
-                            mod = _16QAM;
-                        }
-                        else if (maxMCSPSSCH_ > 16 && maxMCSPSSCH_ < 29 )
-                        {
-                            mod = _64QAM;
-                        }
-
-                        unsigned int i = (mod == _QPSK ? 0 : (mod == _16QAM ? 9 : (mod == _64QAM ? 15 : 0)));
-
-                        const unsigned int* tbsVect = itbs2tbs(mod, SINGLE_ANTENNA_PORT0, 1, mcs - i);
-                        mcsCapacity = tbsVect[totalGrantedBlocks-1];
+                        mcsCapacity = getTbCapacity(totalGrantedBlocks, mcs);
 
                         if (mcsCapacity > pduLength)
                         {
@@ -1263,7 +1075,7 @@ void LteMacVUeMode4::flushHarqBuffers()
                             it2->second->sendSelectedDown();
 
                             // Log transmission to A calculation log
-                            previousTransmissions_[NOW.dbl()] = mode4Grant->getNumSubchannels();
+                            previousTransmissions_.addTransmission(NOW, mode4Grant->getNumSubchannels());
 
                             missedTransmissions_ = 0;
 
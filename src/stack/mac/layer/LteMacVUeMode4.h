@@ -21,7 +21,8 @@
 
 #include "stack/mac/layer/LteMacUeRealisticD2D.h"
 #include "corenetwork/deployer/LteDeployer.h"
-#include <unordered_map>
+#include "stack/mac/layer/ChannelOccupancyHistory.h"
+#include "stack/mac/layer/SidelinkConfiguration.h"
 
 //class LteMode4SchedulingGrant;
 
@@ -29,6 +30,8 @@ class LteMacVUeMode4: public LteMacUeRealisticD2D {
 
 protected:
 
+   static const int NUM_PSSCH_MCS = 29;
+
    /// Lte AMC module
    LteAmc *amc_;
 
@@ -72,11 +75,26 @@ protected:
 
    std::map<UnitList, int> pduRecord_;
 
-   std::vector<std::unordered_map<std::string, double>> cbrPSSCHTxConfigList_;
-   std::vector<std::unordered_map<std::string, double>> cbrLevels_;
+   // sidelink TX configuration, shared by the UEs using the same txConfig
+   std::shared_ptr<const SidelinkConfiguration> txConfig_;
+
+   // TB capacity (bits) for every number of RBs and PSSCH MCS, 0 where the combination is unusable
+   std::vector<unsigned int> tbCapacityTable_;
+   int tbCapacityTableRbs_;
+
+   // subchannel/MCS combination of a new grant
+   struct GrantConfig
+   {
+       int numSubchannels;
+       int mcs;
+   };
+   // Combinations tried by grant generation, in search order, and the running maximum of
+   // their capacity. Index 0 is used without CBR, index 1 + i with CBR config index i.
+   std::vector<std::vector<GrantConfig>> grantConfigs_;
+   std::vector<std::vector<unsigned int>> grantConfigCapacity_;
 
-   std::unordered_map<double, int> previousTransmissions_;
-   std::vector<double> validResourceReservationIntervals_;
+   // subchannels used by past transmissions, over the CR evaluation window
+   ChannelOccupancyHistory previousTransmissions_;
 
    McsTable dlMcsTable_;
    McsTable ulMcsTable_;
@@ -94,6 +112,11 @@ protected:
 
    UeInfo* ueInfo_;
 
+   // flushing of the Tx H-ARQ buffers, scheduled after the main loop of a transmitting TTI
+   cMessage* flushHarqMsg_;
+   // set when a packet from the PHY may have filled the H-ARQ rx buffers
+   bool harqRxPending_;
+
    simsignal_t grantStartTime;
    simsignal_t takingReservedGrant;
    simsignal_t grantBreak;
@@ -154,6 +177,11 @@ protected:
      */
     virtual void handleSelfMessage();
 
+    /**
+     * Returns true if no SDU is waiting in any of the MAC buffers.
+     */
+    bool macBuffersEmpty() const;
+
     /**
      * macPduMake() creates MAC PDUs (one for each CID)
      * by extracting SDUs from Real Mac Buffers according
@@ -166,19 +194,25 @@ protected:
     virtual void macPduMake();
 
     /**
-     * Parse transmission configuration for a Ue
+     * Computes the subchannel and MCS ranges of a grant, for the given CBR config
+     * index (-1 without CBR).
      */
-    void parseUeTxConfig(cXMLElement* xmlConfig);
+    void getGrantSearchRange(int cbrIndex, int& minSubchannels, int& maxSubchannels, int& minMcs, int& maxMcs);
 
     /**
-     * Parse transmission configuration for CBR
+     * Builds tbCapacityTable_ and the grant configuration lists of every CBR config index.
      */
-    void parseCbrTxConfig(cXMLElement* xmlConfig);
+    void buildTbCapacityTables();
 
     /**
-     * Parse transmission configuration for Resource Reservation Intervals
+     * TB capacity of numRbs RBs with the given MCS (0 if unusable)
      */
-    void parseRriConfig(cXMLElement* xmlConfig);
+    unsigned int getTbCapacity(int numRbs, int mcs) const
+    {
+        if (numRbs < 1 || numRbs > tbCapacityTableRbs_ || mcs < 0 || mcs >= NUM_PSSCH_MCS)
+            return 0;
+        return tbCapacityTable_[(numRbs - 1) * NUM_PSSCH_MCS + mcs];
+    }
 
     /**
      * Purges PDUs from the HARQ buffers for sending to the PHY layer.
@@ -0,0 +1,184 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include <map>
+#include <tuple>
+#include "stack/mac/layer/SidelinkConfiguration.h"
+
+// XML element and defaults a configuration has been compiled from
+typedef std::tuple<cXMLElement*, int, int, int, int, int> SidelinkConfigurationKey;
+
+// configurations in use, the MACs own them so that they are freed along with the network
+typedef std::map<SidelinkConfigurationKey, std::weak_ptr<const SidelinkConfiguration> > SidelinkConfigurationMap;
+static SidelinkConfigurationMap sidelinkConfigurations;
+
+std::shared_ptr<const SidelinkConfiguration> SidelinkConfiguration::get(cXMLElement* xmlConfig, const Defaults& defaults)
+{
+    if (xmlConfig == 0)
+        throw cRuntimeError("No sidelink configuration file specified");
+
+    // drop the configurations of a deleted network, whose XML elements may have been freed and their addresses reused
+    for (SidelinkConfigurationMap::iterator it = sidelinkConfigurations.begin(); it != sidelinkConfigurations.end(); )
+    {
+        if (it->second.expired())
+            it = sidelinkConfigurations.erase(it);
+        else
+            ++it;
+    }
+
+    // the element itself also tells apart inline xml() values, which may share the same source location
+    SidelinkConfigurationKey key(xmlConfig, defaults.minMcs, defaults.maxMcs, defaults.minSubchannels,
+            defaults.maxSubchannels, defaults.allowedRetx);
+
+    std::weak_ptr<const SidelinkConfiguration>& cached = sidelinkConfigurations[key];
+    std::shared_ptr<const SidelinkConfiguration> configuration = cached.lock();
+    if (!configuration)
+    {
+        configuration.reset(new SidelinkConfiguration(xmlConfig, defaults));
+        cached = configuration;
+    }
+    return configuration;
+}
+
+SidelinkConfiguration::SidelinkConfiguration(cXMLElement* xmlConfig, const Defaults& defaults)
+{
+    parseUeTxConfig(xmlConfig, defaults);
+    parseRriConfig(xmlConfig);
+    parseCbrTxConfig(xmlConfig, defaults);
+}
+
+void SidelinkConfiguration::parseUeTxConfig(cXMLElement* xmlConfig, const Defaults& defaults)
+{
+    // Get channel Model field which contains parameters fields
+    cXMLElementList ueTxConfig = xmlConfig->getElementsByTagName("userEquipment-txParameters");
+
+    if (ueTxConfig.empty())
+        throw cRuntimeError("No userEquipment-txParameters configuration found in configuration file");
+
+    if (ueTxConfig.size() > 1)
+        throw cRuntimeError("More than one userEquipment-txParameters configuration found in configuration file.");
+
+    cXMLElement* ueTxConfigData = ueTxConfig.front();
+
+    ParameterMap params;
+    getParametersFromXML(ueTxConfigData, params);
+
+    ParameterMap::iterator it = params.find("minMCS-PSSCH");
+    ueTxParameters_.minMcs = (it != params.end()) ? (int)it->second : defaults.minMcs;
+    it = params.find("maxMCS-PSSCH");
+    ueTxParameters_.maxMcs = (it != params.end()) ? (int)it->second : defaults.maxMcs;
+    it = params.find("minSubchannel-NumberPSSCH");
+    ueTxParameters_.minSubchannels = (it != params.end()) ? (int)it->second : defaults.minSubchannels;
+    it = params.find("maxSubchannel-NumberPSSCH");
+    ueTxParameters_.maxSubchannels = (it != params.end()) ? (int)it->second : defaults.maxSubchannels;
+    it = params.find("allowedRetxNumberPSSCH");
+    ueTxParameters_.allowedRetx = (it != params.end()) ? (int)it->second : defaults.allowedRetx;
+    ueTxParameters_.allowedRri = 0;
+    ueTxParameters_.crLimit = 1;
+}
+
+void SidelinkConfiguration::parseRriConfig(cXMLElement* xmlConfig)
+{
+    cXMLElementList rriConfig = xmlConfig->getElementsByTagName("RestrictResourceReservationPeriodList");
+
+    if (rriConfig.empty())
+        throw cRuntimeError("No RestrictResourceReservationPeriodList found in configuration file");
+
+    cXMLElementList rriConfigs = xmlConfig->getElementsByTagName("RestrictResourceReservationPeriod");
+
+    if (rriConfigs.empty())
+        throw cRuntimeError("No RestrictResourceReservationPeriods found in configuration file");
+
+    cXMLElementList::iterator xmlIt;
+    for(xmlIt = rriConfigs.begin(); xmlIt != rriConfigs.end(); xmlIt++)
+    {
+        ParameterMap rriParams;
+        getParametersFromXML((*xmlIt), rriParams);
+        ParameterMap::iterator it = rriParams.find("rri");
+        if (it != rriParams.end())
+        {
+            validRris_.push_back(it->second);
+        }
+    }
+
+    if (validRris_.empty())
+        throw cRuntimeError("No rri found in the RestrictResourceReservationPeriods of the configuration file");
+}
+
+void SidelinkConfiguration::parseCbrTxConfig(cXMLElement* xmlConfig, const Defaults& defaults)
+{
+    cXMLElementList cbrTxConfig = xmlConfig->getElementsByTagName("Sl-CBR-CommonTxConfigList");
+
+    if (cbrTxConfig.empty())
+        throw cRuntimeError("No Sl-CBR-CommonTxConfigList found in configuration file");
+
+    cXMLElement* cbrTxConfigData = cbrTxConfig.front();
+
+    ParameterMap params;
+    getParametersFromXML(cbrTxConfigData, params);
+
+    defaultCbrIndex_ = 0;
+    ParameterMap::iterator it = params.find("default-cbr-ConfigIndex");
+    if (it != params.end())
+        defaultCbrIndex_ = it->second;
+
+    cXMLElementList cbrLevelConfigs = xmlConfig->getElementsByTagName("cbr-ConfigIndex");
+
+    if (cbrLevelConfigs.empty())
+        throw cRuntimeError("No cbr-Levels-Config found in configuration file");
+
+    cXMLElementList::iterator xmlIt;
+    for(xmlIt = cbrLevelConfigs.begin(); xmlIt != cbrLevelConfigs.end(); xmlIt++)
+    {
+        ParameterMap cbrLevelsParams;
+        getParametersFromXML((*xmlIt), cbrLevelsParams);
+
+        ParameterMap::iterator lower = cbrLevelsParams.find("cbr-lower");
+        ParameterMap::iterator upper = cbrLevelsParams.find("cbr-upper");
+        ParameterMap::iterator index = cbrLevelsParams.find("cbr-PSSCH-TxConfig-Index");
+        if (lower == cbrLevelsParams.end() || upper == cbrLevelsParams.end() || index == cbrLevelsParams.end())
+            throw cRuntimeError("cbr-ConfigIndex at %s needs cbr-lower, cbr-upper and cbr-PSSCH-TxConfig-Index", (*xmlIt)->getSourceLocation());
+
+        SidelinkCbrLevel level;
+        level.cbrLower = lower->second;
+        level.cbrUpper = upper->second;
+        level.txConfigIndex = (int)index->second;
+        cbrLevels_.push_back(level);
+    }
+
+    cXMLElementList cbrTxConfigs = xmlConfig->getElementsByTagName("cbr-PSSCH-TxConfig");
+
+    if (cbrTxConfigs.empty())
+        throw cRuntimeError("No CBR-TxConfig found in configuration file");
+
+    cXMLElementList cbrTxParams = xmlConfig->getElementsByTagName("txParameters");
+
+    for(xmlIt = cbrTxParams.begin(); xmlIt != cbrTxParams.end(); xmlIt++)
+    {
+        ParameterMap cbrParams;
+        getParametersFromXML((*xmlIt), cbrParams);
+
+        SidelinkTxParameters txParameters;
+        it = cbrParams.find("minMCS-PSSCH");
+        txParameters.minMcs = (it != cbrParams.end()) ? (int)it->second : defaults.minMcs;
+        it = cbrParams.find("maxMCS-PSSCH");
+        txParameters.maxMcs = (it != cbrParams.end()) ? (int)it->second : defaults.maxMcs;
+        it = cbrParams.find("minSubchannel-NumberPSSCH");
+        txParameters.minSubchannels = (it != cbrParams.end()) ? (int)it->second : defaults.minSubchannels;
+        it = cbrParams.find("maxSubchannel-NumberPSSCH");
+        txParameters.maxSubchannels = (it != cbrParams.end()) ? (int)it->second : defaults.maxSubchannels;
+        it = cbrParams.find("allowedRetxNumberPSSCH");
+        txParameters.allowedRetx = (it != cbrParams.end()) ? (int)it->second : defaults.allowedRetx;
+        it = cbrParams.find("allowedRRI");
+        txParameters.allowedRri = (it != cbrParams.end()) ? (double)it->second : validRris_.front();
+        it = cbrParams.find("cr-Limit");
+        txParameters.crLimit = (it != cbrParams.end()) ? (double)it->second : 1;
+        cbrTxConfigs_.push_back(txParameters);
+    }
+}
@@ -0,0 +1,111 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_SIDELINKCONFIGURATION_H_
+#define _LTE_SIDELINKCONFIGURATION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "common/LteCommon.h"
+
+/**
+ * PSSCH transmission parameters, either of the UE (userEquipment-txParameters)
+ * or of a CBR config index (cbr-PSSCH-TxConfig/txParameters).
+ */
+struct SidelinkTxParameters
+{
+    int minMcs;
+    int maxMcs;
+    int minSubchannels;
+    int maxSubchannels;
+    int allowedRetx;
+    double allowedRri;
+    // 1 when not configured, i.e. never exceeded
+    double crLimit;
+};
+
+/**
+ * CBR range mapped to a PSSCH TX config index (cbr-Levels-Config/cbr-ConfigIndex).
+ */
+struct SidelinkCbrLevel
+{
+    double cbrLower;
+    double cbrUpper;
+    int txConfigIndex;
+};
+
+/**
+ * Sidelink TX configuration of Mode 4 UEs, compiled from the txConfig XML.
+ *
+ * The configuration is immutable once built, and every MAC using the same XML
+ * element (and the same NED defaults for the missing values) shares a single
+ * instance, obtained with get(). The instance is freed with the last MAC
+ * using it, i.e. at the latest when the network is deleted.
+ */
+class SidelinkConfiguration
+{
+  public:
+    // NED parameters used for the values missing in the XML
+    struct Defaults
+    {
+        int minMcs;
+        int maxMcs;
+        int minSubchannels;
+        int maxSubchannels;
+        int allowedRetx;
+    };
+
+  protected:
+    SidelinkTxParameters ueTxParameters_;
+    std::vector<double> validRris_;
+    int defaultCbrIndex_;
+    std::vector<SidelinkCbrLevel> cbrLevels_;
+    std::vector<SidelinkTxParameters> cbrTxConfigs_;
+
+    SidelinkConfiguration(cXMLElement* xmlConfig, const Defaults& defaults);
+
+    void parseUeTxConfig(cXMLElement* xmlConfig, const Defaults& defaults);
+    void parseRriConfig(cXMLElement* xmlConfig);
+    void parseCbrTxConfig(cXMLElement* xmlConfig, const Defaults& defaults);
+
+  public:
+    /**
+     * Returns the configuration compiled from the given XML element, building
+     * it unless another MAC of the network already did.
+     */
+    static std::shared_ptr<const SidelinkConfiguration> get(cXMLElement* xmlConfig, const Defaults& defaults);
+
+    const SidelinkTxParameters& getUeTxParameters() const
+    {
+        return ueTxParameters_;
+    }
+    const std::vector<double>& getValidRris() const
+    {
+        return validRris_;
+    }
+    int getDefaultCbrIndex() const
+    {
+        return defaultCbrIndex_;
+    }
+    const std::vector<SidelinkCbrLevel>& getCbrLevels() const
+    {
+        return cbrLevels_;
+    }
+    const std::vector<SidelinkTxParameters>& getCbrTxConfigs() const
+    {
+        return cbrTxConfigs_;
+    }
+    const SidelinkTxParameters& getCbrTxConfig(int index) const
+    {
+        return cbrTxConfigs_.at(index);
+    }
+};
+
+#endif
@@ -0,0 +1,67 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_CHANNELSTATE_H_
+#define _LTE_CHANNELSTATE_H_
+
+#include <stdint.h>
+#include <unordered_map>
+#include "common/LteCommon.h"
+#include "stack/phy/ChannelModel/JakesFadingEngine.h"
+
+/*
+ * State of a D2D link, as last computed by LteRealisticChannelModel::getAttenuation_D2D.
+ * The path loss is reused until either end moved by more than the link state cache distance,
+ * while LOS and shadowing are redrawn once the pair moved by more than the correlation distance,
+ * or the transmitter did at its current speed since correlationTime.
+ */
+struct LinkState
+{
+    inet::Coord txCoord;
+    inet::Coord rxCoord;
+    double pathLoss;
+    // positions at which LOS and shadowing were last drawn
+    inet::Coord txCorrelationCoord;
+    inet::Coord rxCorrelationCoord;
+    simtime_t correlationTime;
+    bool los;
+    double shadowing;
+};
+
+// D2D link states, keyed by transmitter and receiver (see LteRealisticChannelModel::linkKey)
+typedef std::unordered_map<unsigned int, LinkState> LinkStateMap;
+
+/**
+ * Per-link and per-node state of the realistic channel model.
+ *
+ * Every channel model owns one. When the network contains a
+ * ChannelStateManager, the channel models also refer to the state of the
+ * manager, which holds no per-link entry: the LOS, shadowing and coherent
+ * Nakagami fading of a D2D link are derived on demand from linkSeed and the
+ * positions of its two ends, and the jakes fading paths are kept per transmitter.
+ */
+class ChannelState
+{
+  public:
+    // D2D link states, only used by the channel model owning this state
+    LinkStateMap linkStates;
+
+    // seed of the per-link random streams (shared state only)
+    uint64_t linkSeed;
+
+    // for each node and for each band, the jakes fading paths
+    JakesFadingEngine jakesFading;
+
+    ChannelState()
+    {
+        linkSeed = 0;
+    }
+};
+
+#endif
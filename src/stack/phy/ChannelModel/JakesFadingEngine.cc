@@ -0,0 +1,140 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "stack/phy/ChannelModel/JakesFadingEngine.h"
+#include "common/LteDbMath.h"
+
+JakesFadingEngine::JakesFadingEngine()
+{
+    numBands_ = 0;
+    numPaths_ = 0;
+    carrierFrequency_ = 0;
+    pathPower_ = 0;
+}
+
+void JakesFadingEngine::initialise(unsigned int numBands, int numPaths, double carrierFrequency)
+{
+    numBands_ = numBands;
+    numPaths_ = numPaths;
+    carrierFrequency_ = carrierFrequency;
+    pathPower_ = 1.00 / numPaths;
+    nodes_.clear();
+}
+
+void JakesFadingEngine::addNode(MacNodeId nodeId, const std::vector<double>& cosAngleOfArrival,
+        const std::vector<double>& delaySpread)
+{
+    unsigned int size = numBands_ * numPaths_;
+    if (cosAngleOfArrival.size() != size || delaySpread.size() != size)
+        throw cRuntimeError("JakesFadingEngine::addNode - expected %d paths for node %d", size, nodeId);
+
+    NodeState& state = nodes_[nodeId];
+    state.cosAngleOfArrival = cosAngleOfArrival;
+    // phases at time 0, where only the delay spread (f-selectivity) contributes
+    state.phase.resize(size);
+    for (unsigned int i = 0; i < size; i++)
+        state.phase[i] = -delaySpread[i] * carrierFrequency_;
+    state.re.resize(size);
+    state.im.resize(size);
+    state.rotationRe.resize(size);
+    state.rotationIm.resize(size);
+    state.rotationStep = 0;
+    state.rotationDoppler = -1;
+    state.rotations = REANCHOR_PERIOD;
+    state.time = 0;
+    state.hasFading = false;
+    state.fading.resize(numBands_);
+}
+
+double JakesFadingEngine::getFading(MacNodeId nodeId, unsigned int band, double dopplerShift, simtime_t time)
+{
+    NodeState& state = nodes_.at(nodeId);
+    if (time != state.time || !state.hasFading)
+        computeFading(state, dopplerShift, time);
+    return state.fading[band];
+}
+
+void JakesFadingEngine::anchor(NodeState& state)
+{
+    unsigned int size = numBands_ * numPaths_;
+    for (unsigned int i = 0; i < size; i++)
+    {
+        state.phase[i] -= floor(state.phase[i]);
+        double phi = 2.00 * M_PI * state.phase[i];
+        state.re[i] = cos(phi);
+        state.im[i] = -sin(phi);
+    }
+    state.rotations = 0;
+}
+
+void JakesFadingEngine::updateRotation(NodeState& state, double dopplerShift, simtime_t step)
+{
+    unsigned int size = numBands_ * numPaths_;
+    double dt = step.dbl();
+    for (unsigned int i = 0; i < size; i++)
+    {
+        double phi = 2.00 * M_PI * state.cosAngleOfArrival[i] * dopplerShift * dt;
+        state.rotationRe[i] = cos(phi);
+        state.rotationIm[i] = -sin(phi);
+    }
+    state.rotationStep = step;
+    state.rotationDoppler = dopplerShift;
+}
+
+void JakesFadingEngine::computeFading(NodeState& state, double dopplerShift, simtime_t time)
+{
+    unsigned int size = numBands_ * numPaths_;
+    simtime_t step = time - state.time;
+    if (step != 0)
+    {
+        // Phase shift due to Doppler (t-selectivity) over the elapsed time
+        double dt = step.dbl();
+        for (unsigned int i = 0; i < size; i++)
+            state.phase[i] += state.cosAngleOfArrival[i] * dopplerShift * dt;
+    }
+
+    if (step == 0 || state.rotations >= REANCHOR_PERIOD || step != state.rotationStep || dopplerShift != state.rotationDoppler)
+    {
+        // closed form, and rotation of the next step if it is the same as this one
+        anchor(state);
+        if (step != 0 && (step != state.rotationStep || dopplerShift != state.rotationDoppler))
+            updateRotation(state, dopplerShift, step);
+    }
+    else
+    {
+        double* re = state.re.data();
+        double* im = state.im.data();
+        const double* rotationRe = state.rotationRe.data();
+        const double* rotationIm = state.rotationIm.data();
+        for (unsigned int i = 0; i < size; i++)
+        {
+            double r = re[i] * rotationRe[i] - im[i] * rotationIm[i];
+            im[i] = re[i] * rotationIm[i] + im[i] * rotationRe[i];
+            re[i] = r;
+        }
+        state.rotations++;
+    }
+
+    for (unsigned int band = 0; band < numBands_; band++)
+    {
+        double re_h = 0;
+        double im_h = 0;
+        unsigned int first = band * numPaths_;
+        for (int i = 0; i < numPaths_; i++)
+        {
+            re_h += state.re[first + i];
+            im_h += state.im[first + i];
+        }
+        // |H_f|^2 = absolute channel impulse response due to fading, may be >1 due to constructive interference
+        state.fading[band] = pathPower_ * (re_h * re_h + im_h * im_h);
+    }
+    linearToDb(state.fading.data(), state.fading.data(), numBands_);
+    state.time = time;
+    state.hasFading = true;
+}
@@ -0,0 +1,122 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_JAKESFADINGENGINE_H_
+#define _LTE_JAKESFADINGENGINE_H_
+
+#include <unordered_map>
+#include "common/LteCommon.h"
+
+/**
+ * Jakes fading (Clarke's one ring model plus the f-selectivity of Cavers),
+ * as in LteRealisticChannelModel::jakesFading.
+ *
+ * For each node, the state of every (band, path) is kept in contiguous
+ * arrays indexed by band * numPaths + path: the phase of the path and its
+ * phasor. When the fading is requested at a new time, the phase of each path
+ * is advanced by the Doppler shift times the elapsed time, and its phasor
+ * is rotated by the same angle. The rotation of each path is cached, so a
+ * node sampled at a constant interval and speed costs one complex product
+ * per path instead of a sine and a cosine. The phasors are recomputed from
+ * the phases (closed form) whenever the rotation changes and every
+ * REANCHOR_PERIOD rotations, which bounds the rounding drift. The fading of
+ * all bands is computed at once, so that the other bands of the same TTI
+ * are a single load.
+ *
+ * With a constant Doppler shift, the fading is the closed form of
+ * jakesFading. When the speed changes, the phase of a path accumulates the
+ * Doppler shift over time rather than jumping to cos(aoa) * fd * t, so the
+ * fading stays continuous: its statistics are the same.
+ */
+class JakesFadingEngine
+{
+  public:
+    // number of rotations between two closed-form evaluations of the phasors
+    static const unsigned int REANCHOR_PERIOD = 100;
+
+  protected:
+    struct NodeState
+    {
+        // [band * numPaths + path]
+        std::vector<double> cosAngleOfArrival;
+        // phase of the path (cycles), reduced to [0, 1) when the phasors are anchored
+        std::vector<double> phase;
+        // phasor of the path, exp(-j 2 pi phase)
+        std::vector<double> re;
+        std::vector<double> im;
+        // rotation of the path for rotationStep at rotationDoppler
+        std::vector<double> rotationRe;
+        std::vector<double> rotationIm;
+        simtime_t rotationStep;
+        double rotationDoppler;
+        // rotations since the phasors were last computed from the phases
+        unsigned int rotations;
+        // time of the phases, and whether the fading has been computed for it
+        simtime_t time;
+        bool hasFading;
+        // fading (dB) of each band
+        std::vector<double> fading;
+    };
+
+    unsigned int numBands_;
+    int numPaths_;
+    // carrier frequency (Hz)
+    double carrierFrequency_;
+    // power of each path, so that the paths sum up to unit power
+    double pathPower_;
+
+    std::unordered_map<MacNodeId, NodeState> nodes_;
+
+    void computeFading(NodeState& state, double dopplerShift, simtime_t time);
+    void anchor(NodeState& state);
+    void updateRotation(NodeState& state, double dopplerShift, simtime_t step);
+
+  public:
+    JakesFadingEngine();
+
+    /**
+     * @param carrierFrequency carrier frequency in Hz
+     */
+    void initialise(unsigned int numBands, int numPaths, double carrierFrequency);
+
+    bool isInitialised() const
+    {
+        return numPaths_ > 0;
+    }
+    unsigned int getNumBands() const
+    {
+        return numBands_;
+    }
+    int getNumPaths() const
+    {
+        return numPaths_;
+    }
+
+    bool hasNode(MacNodeId nodeId) const
+    {
+        return nodes_.find(nodeId) != nodes_.end();
+    }
+
+    /**
+     * Creates the paths of a node.
+     *
+     * @param cosAngleOfArrival cosine of the angle of arrival of each (band, path)
+     * @param delaySpread delay of each (band, path), in seconds
+     */
+    void addNode(MacNodeId nodeId, const std::vector<double>& cosAngleOfArrival, const std::vector<double>& delaySpread);
+
+    /**
+     * Returns the fading (dB) of a band of an existing node at the given time,
+     * advancing the paths of all its bands with the given Doppler shift if the
+     * time changed since the last call.
+     */
+    double getFading(MacNodeId nodeId, unsigned int band, double dopplerShift, simtime_t time);
+};
+
+#endif
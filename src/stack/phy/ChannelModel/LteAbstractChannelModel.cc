@@ -0,0 +1,321 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "stack/phy/ChannelModel/LteAbstractChannelModel.h"
+#include "stack/phy/packet/LteAirFrame.h"
+#include "common/LteDbMath.h"
+#include "common/CounterRng.h"
+
+// PSCCH plus one row per PSSCH MCS
+static const unsigned int PRR_TABLE_ROWS = 1 + 29;
+// the SCI is always sent on two RBs
+static const int SCI_BANDS = 2;
+
+// tables already loaded or generated in this process, by file name
+static std::map<std::string, std::shared_ptr<const SidelinkPrrTable> > prrTables;
+
+double SidelinkPrrTable::lookup(unsigned int row, double distance, double sinr) const
+{
+    unsigned int distanceBin = (distance <= 0) ? 0 : (unsigned int)(distance / distanceStep);
+    if (distanceBin >= numDistances)
+        distanceBin = numDistances - 1;
+    const double* values = &prr[(row * numDistances + distanceBin) * numSinrs];
+
+    // linear interpolation between the two closest SINR samples
+    double x = (sinr - minSinr) / sinrStep;
+    if (!(x > 0))
+        return values[0];
+    if (x >= numSinrs - 1)
+        return values[numSinrs - 1];
+    unsigned int i = (unsigned int)x;
+    double f = x - i;
+    return values[i] + f * (values[i + 1] - values[i]);
+}
+
+LteAbstractChannelModel::LteAbstractChannelModel(ParameterMap& params, const inet::Coord& myCoord, unsigned int band) :
+        LteRealisticChannelModel(params, myCoord, band)
+{
+    if (fading_ && fadingType_ != NAKAGAMI)
+        throw cRuntimeError("LteAbstractChannelModel: the PRR tables can only be generated for NAKAGAMI fading or without fading");
+    tableFading_ = fading_;
+    // the received power is the average one, the fading is accounted for by the tables
+    fading_ = false;
+
+    ParameterMap::iterator it;
+
+    std::string fileName = "sidelink_prr_tables.txt";
+    it = params.find("prr-table-file");
+    if (it != params.end())
+        fileName = it->second.stringValue();
+
+    tableMaxDistance_ = 1500;
+    it = params.find("prr-table-max-distance");
+    if (it != params.end())
+        tableMaxDistance_ = it->second.doubleValue();
+
+    tableDistanceStep_ = 10;
+    it = params.find("prr-table-distance-step");
+    if (it != params.end())
+        tableDistanceStep_ = it->second.doubleValue();
+
+    tableMinSinr_ = -20;
+    it = params.find("prr-table-min-sinr");
+    if (it != params.end())
+        tableMinSinr_ = it->second.doubleValue();
+
+    tableMaxSinr_ = 50;
+    it = params.find("prr-table-max-sinr");
+    if (it != params.end())
+        tableMaxSinr_ = it->second.doubleValue();
+
+    tableSinrStep_ = 0.5;
+    it = params.find("prr-table-sinr-step");
+    if (it != params.end())
+        tableSinrStep_ = it->second.doubleValue();
+
+    tableSamples_ = 500;
+    it = params.find("prr-table-samples");
+    if (it != params.end())
+        tableSamples_ = it->second;
+
+    tableTbBands_ = 10;
+    it = params.find("prr-table-tb-bands");
+    if (it != params.end())
+        tableTbBands_ = it->second;
+
+    tableSeed_ = 1;
+    it = params.find("prr-table-seed");
+    if (it != params.end())
+        tableSeed_ = it->second.longValue();
+
+    if (tableMaxDistance_ <= 0 || tableDistanceStep_ <= 0 || tableSinrStep_ <= 0 || tableMaxSinr_ <= tableMinSinr_)
+        throw cRuntimeError("LteAbstractChannelModel: the PRR table ranges and steps must be positive");
+    if (tableSamples_ < 1 || tableTbBands_ < 1)
+        throw cRuntimeError("LteAbstractChannelModel: prr-table-samples and prr-table-tb-bands must be at least 1");
+
+    std::string key = getTableKey();
+    std::shared_ptr<const SidelinkPrrTable>& cached = prrTables[fileName];
+    if (!cached || cached->key != key)
+    {
+        SidelinkPrrTable* table = loadTable(fileName.c_str(), key);
+        if (table == NULL)
+        {
+            table = generateTable(key);
+            writeTable(fileName.c_str(), *table);
+        }
+        cached.reset(table);
+    }
+    prrTable_ = cached;
+}
+
+LteAbstractChannelModel::~LteAbstractChannelModel()
+{
+}
+
+std::string LteAbstractChannelModel::getTableKey() const
+{
+    std::ostringstream key;
+    key.precision(17);
+    key << "fading=" << (tableFading_ ? "NAKAGAMI" : "none")
+        << ";shape=" << shapeFactor_
+        << ";carrier=" << carrierFrequency_
+        << ";analytical=" << analytical_
+        << ";distance=" << tableMaxDistance_ << "/" << tableDistanceStep_
+        << ";sinr=" << tableMinSinr_ << ":" << tableMaxSinr_ << "/" << tableSinrStep_
+        << ";samples=" << tableSamples_
+        << ";tbBands=" << tableTbBands_
+        << ";seed=" << tableSeed_;
+    return key.str();
+}
+
+SidelinkPrrTable* LteAbstractChannelModel::loadTable(const char* fileName, const std::string& key)
+{
+    std::ifstream file(fileName);
+    if (!file)
+        return NULL;
+
+    std::string line;
+    std::getline(file, line);   // comment
+    std::getline(file, line);
+    if (line != "key " + key)
+    {
+        EV_WARN << "LteAbstractChannelModel::loadTable - " << fileName << " was generated with different parameters, generating it again" << endl;
+        return NULL;
+    }
+
+    SidelinkPrrTable* table = new SidelinkPrrTable();
+    table->key = key;
+    std::string tag;
+    file >> tag >> table->numRows >> table->numDistances >> table->numSinrs >> table->distanceStep >> table->minSinr >> table->sinrStep;
+    if (!file || tag != "size")
+        throw cRuntimeError("LteAbstractChannelModel::loadTable - malformed header in %s", fileName);
+
+    table->prr.resize(table->numRows * table->numDistances * table->numSinrs);
+    for (unsigned int i = 0; i < table->prr.size(); i++)
+        file >> table->prr[i];
+    if (!file)
+        throw cRuntimeError("LteAbstractChannelModel::loadTable - %s is truncated", fileName);
+
+    EV << "LteAbstractChannelModel::loadTable - PRR tables loaded from " << fileName << endl;
+    return table;
+}
+
+SidelinkPrrTable* LteAbstractChannelModel::generateTable(const std::string& key)
+{
+    SidelinkPrrTable* table = new SidelinkPrrTable();
+    table->key = key;
+    table->numRows = PRR_TABLE_ROWS;
+    table->numDistances = (unsigned int)ceil(tableMaxDistance_ / tableDistanceStep_);
+    table->numSinrs = (unsigned int)floor((tableMaxSinr_ - tableMinSinr_) / tableSinrStep_) + 1;
+    table->distanceStep = tableDistanceStep_;
+    table->minSinr = tableMinSinr_;
+    table->sinrStep = tableSinrStep_;
+    table->prr.resize(table->numRows * table->numDistances * table->numSinrs);
+
+    // The realistic model averages the SINR of the used bands in linear, each band having
+    // its own fading: the average is the unfaded SINR plus the fading gain of the sample,
+    // hence the same gains serve every row and every SINR of a distance
+    int numSamples = tableFading_ ? tableSamples_ : 1;
+    std::vector<double> sciGains(numSamples, 0.0);
+    std::vector<double> tbGains(numSamples, 0.0);
+    std::vector<double> bandGains(std::max(SCI_BANDS, tableTbBands_));
+
+    for (unsigned int d = 0; d < table->numDistances; d++)
+    {
+        if (tableFading_)
+        {
+            // own stream per bin, independent of the simulation RNGs
+            CounterRng binRng(CounterRng::makeKey(tableSeed_, d));
+            cRNG* rng = &binRng;
+
+            // center of the distance bin
+            double scale = getNakagamiScale((d + 0.5) * tableDistanceStep_);
+            for (int k = 0; k < numSamples; k++)
+            {
+                for (int b = 0; b < tableTbBands_; b++)
+                    bandGains[b] = scale * gamma_d(rng, shapeFactor_, 1.0);
+                dBToLinear(bandGains.data(), bandGains.data(), tableTbBands_);
+
+                double sum = 0;
+                for (int b = 0; b < tableTbBands_; b++)
+                    sum += bandGains[b];
+                tbGains[k] = linearToDb(sum / tableTbBands_);
+
+                for (int b = 0; b < SCI_BANDS; b++)
+                    bandGains[b] = scale * gamma_d(rng, shapeFactor_, 1.0);
+                dBToLinear(bandGains.data(), bandGains.data(), SCI_BANDS);
+                sciGains[k] = linearToDb((bandGains[0] + bandGains[1]) / SCI_BANDS);
+            }
+        }
+
+        for (unsigned int row = 0; row < table->numRows; row++)
+        {
+            bool sci = (row == 0);
+            const std::vector<double>& gains = sci ? sciGains : tbGains;
+            double* values = &table->prr[(row * table->numDistances + d) * table->numSinrs];
+            for (unsigned int s = 0; s < table->numSinrs; s++)
+            {
+                double sinr = tableMinSinr_ + s * tableSinrStep_;
+                double bler = 0;
+                for (int k = 0; k < numSamples; k++)
+                    bler += getSidelinkBler(sci, row - 1, sinr + gains[k]);
+                values[s] = 1 - bler / numSamples;
+            }
+        }
+    }
+
+    EV << "LteAbstractChannelModel::generateTable - PRR tables generated (" << key << ")" << endl;
+    return table;
+}
+
+void LteAbstractChannelModel::writeTable(const char* fileName, const SidelinkPrrTable& table)
+{
+    // written aside and renamed, so that a concurrent run never reads a partial file
+    std::ostringstream tmpName;
+    tmpName << fileName << ".tmp" << getpid();
+    std::ofstream file(tmpName.str().c_str());
+    if (!file)
+    {
+        EV_WARN << "LteAbstractChannelModel::writeTable - cannot write " << tmpName.str() << ", the tables will be generated again by the next run" << endl;
+        return;
+    }
+
+    file.precision(17);
+    file << "# sidelink PRR tables of LteAbstractChannelModel: rows SCI, MCS 0-28; one line per row and distance bin" << endl;
+    file << "key " << table.key << endl;
+    file << "size " << table.numRows << " " << table.numDistances << " " << table.numSinrs << " "
+         << table.distanceStep << " " << table.minSinr << " " << table.sinrStep << endl;
+    for (unsigned int line = 0; line < table.numRows * table.numDistances; line++)
+    {
+        const double* values = &table.prr[line * table.numSinrs];
+        for (unsigned int s = 0; s < table.numSinrs; s++)
+            file << (s > 0 ? " " : "") << values[s];
+        file << endl;
+    }
+    file.close();
+
+    if (!file || std::rename(tmpName.str().c_str(), fileName) != 0)
+    {
+        // another run may have renamed the same (identical) tables in place meanwhile
+        std::remove(tmpName.str().c_str());
+        EV_WARN << "LteAbstractChannelModel::writeTable - cannot write " << fileName << ", the tables will be generated again by the next run" << endl;
+    }
+}
+
+std::tuple<bool, bool> LteAbstractChannelModel::error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, const BandMeasurements& measurements, int mcs)
+{
+    EV << "LteAbstractChannelModel::error_Mode4" << endl;
+
+    bool sci = (lteInfo->getFrameType() == SCIPKT);
+    unsigned int row = sci ? 0 : 1 + mcs;
+    if (row >= prrTable_->numRows)
+        throw cRuntimeError("LteAbstractChannelModel::error_Mode4 - no PRR table for MCS %d", mcs);
+
+    // SNR of each band, from the (unfaded) RSRP
+    std::vector<double>& snrV = snrBuffer_;
+    computeSINR_D2D(lteInfo, lteInfo->getDestId(), myCoord_, 1, measurements.rsrpVector, false, snrV);
+    const std::vector<double>& sinrVector = measurements.sinrVector;
+
+    double averageSnr = 0;
+    double averageSinr = 0;
+    unsigned int countUsedRbs = 0;
+
+    const RbMap& rbmap = lteInfo->getGrantedBlocks();
+    RbMap::const_iterator it;
+    std::map<Band, unsigned int>::const_iterator jt;
+    //for each Remote unit used to transmit the packet
+    for (it = rbmap.begin(); it != rbmap.end(); ++it) {
+        //for each logical band used to transmit the packet
+        for (jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            //this Rb is not allocated
+            if (jt->second == 0) continue;
+
+            averageSnr += dBToLinear(snrV[jt->first]);
+            averageSinr += dBToLinear(sinrVector[jt->first]);
+            countUsedRbs++;
+        }
+    }
+    if (countUsedRbs == 0)
+        return std::make_tuple(false, false);
+
+    averageSnr = linearToDb(averageSnr / countUsedRbs);
+    averageSinr = linearToDb(averageSinr / countUsedRbs);
+
+    double distance = lteInfo->getCoord().distance(myCoord_);
+    double prrSnr = prrTable_->lookup(row, distance, averageSnr);
+    double prrSinr = prrTable_->lookup(row, distance, averageSinr);
+
+    // one draw for both results, as in the realistic model: the frame is lost if er <= BLER
+    double er = uniform(rng_, 0.0, 1.0);
+    return std::make_tuple(er > 1 - prrSnr, er > 1 - prrSinr);
+}
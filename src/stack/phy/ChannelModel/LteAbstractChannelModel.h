@@ -0,0 +1,96 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_LTEABSTRACTCHANNELMODEL_H_
+#define _LTE_LTEABSTRACTCHANNELMODEL_H_
+
+#include <memory>
+#include <string>
+#include "stack/phy/ChannelModel/LteRealisticChannelModel.h"
+
+/*
+ * Packet reception ratio of sidelink transmissions, averaged over the fading
+ * of the realistic channel model.
+ *
+ * Row 0 is the PSCCH (SCI), row 1 + m the PSSCH with MCS m. Each row holds,
+ * for every distance bin, the PRR sampled every sinrStep dB of the average
+ * SINR the frame would have without fading, from minSinr on.
+ */
+struct SidelinkPrrTable
+{
+    // parameters the table was generated with, written in the table file
+    std::string key;
+    unsigned int numRows;
+    unsigned int numDistances;
+    unsigned int numSinrs;
+    double distanceStep;
+    double minSinr;
+    double sinrStep;
+    // [(row * numDistances + distance) * numSinrs + sinr]
+    std::vector<double> prr;
+
+    double lookup(unsigned int row, double distance, double sinr) const;
+};
+
+/**
+ * Abstracted PHY for long Mode 4 sweeps.
+ *
+ * Path loss, shadowing and interference are computed as in the realistic
+ * model, but the received power is taken without fading, and SCI/TB
+ * receptions are decided by looking the PRR up in precomputed tables indexed
+ * by distance, MCS and average SINR (the aggregate interference enters through
+ * the latter). This skips the per-band fading draws of every frame and the
+ * per-frame BLER evaluation.
+ *
+ * The tables are read from the file given by the "prr-table-file" parameter.
+ * When the file is missing or has been generated with different parameters,
+ * they are generated from the full model, by sampling the per-band fading of
+ * the realistic model (NAKAGAMI or no fading) and its BLER curves, and the
+ * file is written for the following runs.
+ *
+ * The fading samples are drawn from private counter-based streams (one per
+ * distance bin) keyed by "prr-table-seed", not from the simulation RNGs, so
+ * the tables only depend on their parameters and generating them does not
+ * change the results of the run. The file is written to a temporary file
+ * and renamed into place, so that concurrent runs never read a partial one.
+ */
+class LteAbstractChannelModel : public LteRealisticChannelModel
+{
+  protected:
+    std::shared_ptr<const SidelinkPrrTable> prrTable_;
+
+    // parameters of the table generation
+    double tableMaxDistance_;
+    double tableDistanceStep_;
+    double tableMinSinr_;
+    double tableMaxSinr_;
+    double tableSinrStep_;
+    int tableSamples_;
+    int tableTbBands_;
+    // seed of the private streams the tables are generated from
+    unsigned long tableSeed_;
+    // fading the tables average over (the received power itself is not faded)
+    bool tableFading_;
+
+    std::string getTableKey() const;
+    SidelinkPrrTable* loadTable(const char* fileName, const std::string& key);
+    SidelinkPrrTable* generateTable(const std::string& key);
+    void writeTable(const char* fileName, const SidelinkPrrTable& table);
+
+  public:
+    LteAbstractChannelModel(ParameterMap& params, const inet::Coord& myCoord, unsigned int band);
+    virtual ~LteAbstractChannelModel();
+
+    /*
+     * Decides the reception of a SCI or TB from the PRR tables, with and without interference
+     */
+    virtual std::tuple<bool, bool> error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, const BandMeasurements& measurements, int mcs);
+};
+
+#endif
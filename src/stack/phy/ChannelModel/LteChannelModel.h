@@ -61,22 +61,23 @@ class LteChannelModel
      * @param lteinfo pointer to the user control info
      * @param rsrpVector the received signal for each RB, if it has already been computed
      */
-    virtual bool error_D2D(LteAirFrame *frame, UserControlInfo* lteInfo, std::vector<double> rsrpVector)=0;
+    virtual bool error_D2D(LteAirFrame *frame, UserControlInfo* lteInfo, const std::vector<double>& rsrpVector)=0;
     /*
      * Compute the error probability of the transmitted packet according to mcs used, txmode, and the received power
      * after that it throws a random number in order to check if this packet will be corrupted or not
      *
      * @param frame pointer to the packet
      * @param lteinfo pointer to the user control info
-     * @param rsrpVector the received signal for each RB, if it has already been computed
+     * @param measurements the RSRP and SINR previously computed for each RB
      * @param mcs the modulation and coding scheme used in sending the message.
      * @returns a tuple specifying whether it was successfully received based on SNR and SINR
      */
-    virtual std::tuple<bool, bool> error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, std::vector<double> rsrpVector, std::vector<double> sinrVector, int mcs)=0;
+    virtual std::tuple<bool, bool> error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, const BandMeasurements& measurements, int mcs)=0;
     /*
      * Compute Received useful signal for D2D transmissions
+     * Fills the RSRP vector and the attenuation of the given measurements
      */
-    virtual std::tuple<std::vector<double>, double> getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord)=0;
+    virtual void getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord, BandMeasurements& measurements)=0;
     /*
      * Compute sinr (D2D) for each band for user nodeId according to pathloss, shadowing (optional) and multipath fading
      *
@@ -84,14 +85,15 @@ class LteChannelModel
      * @param lteinfo pointer to the user control info
      */
     virtual std::vector<double> getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo,MacNodeId peerUeId,inet::Coord peerUeCoord,MacNodeId enbId=0)=0;
-    virtual std::vector<double> getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector, bool interference)=0;
+    virtual std::vector<double> getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,const std::vector<double>& rsrpVector, bool interference)=0;
     /*
      * Compute RSSI for each band for user nodeId according to pathloss, shadowing (optional) and multipath fading
+     * Fills the RSSI and SINR vectors of the given measurements from their RSRP vector
      *
      * @param frame pointer to the packet
      * @param lteinfo pointer to the user control info
      */
-    virtual std::tuple<std::vector<double>, std::vector<double>> getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector)=0;
+    virtual void getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId, BandMeasurements& measurements)=0;
 
     virtual double getTxRxDistance(UserControlInfo* lteInfo)=0;
 };
@@ -48,12 +48,10 @@ std::vector<double> LteDummyChannelModel::getSINR(LteAirFrame *frame, UserContro
     return tmp;
 }
 
-std::tuple<std::vector<double>, double>  LteDummyChannelModel::getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord)
+void LteDummyChannelModel::getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord, BandMeasurements& measurements)
 {
-    std::vector<double> tmp1;
-    double tmp2 = 0.0;
-    tmp1.push_back(10000);
-    return std::make_tuple(tmp1, tmp2);
+    measurements.rsrpVector.assign(1, 10000);
+    measurements.attenuation = 0.0;
 }
 
 std::vector<double> LteDummyChannelModel::getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId)
@@ -65,7 +63,7 @@ std::vector<double> LteDummyChannelModel::getSINR_D2D(LteAirFrame *frame, UserCo
     return tmp;
 }
 
-std::vector<double> LteDummyChannelModel::getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector, bool interference=true)
+std::vector<double> LteDummyChannelModel::getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,const std::vector<double>& rsrpVector, bool interference=true)
 {
     std::vector<double> tmp;
     tmp.push_back(10000);
@@ -74,14 +72,10 @@ std::vector<double> LteDummyChannelModel::getSINR_D2D(LteAirFrame *frame, UserCo
     return tmp;
 }
 
-std::tuple<std::vector<double>, std::vector<double>> LteDummyChannelModel::getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector)
+void LteDummyChannelModel::getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId, BandMeasurements& measurements)
 {
-    std::vector<double> tmp1;
-    std::vector<double> tmp2;
-    tmp1.push_back(1000);
-    tmp2.push_back(1000);
-
-    return std::make_tuple(tmp1, tmp2);
+    measurements.rssiVector.assign(1, 1000);
+    measurements.sinrVector.assign(1, 1000);
 }
 
 std::vector<double> LteDummyChannelModel::getSIR(LteAirFrame *frame, UserControlInfo* lteInfo)
@@ -120,7 +114,7 @@ bool LteDummyChannelModel::error(LteAirFrame *frame, UserControlInfo* lteInfo)
     return true;
 }
 
-bool LteDummyChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lteInfo,std::vector<double> rsrpVector)
+bool LteDummyChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lteInfo,const std::vector<double>& rsrpVector)
 {
     // Number of RTX
     unsigned char nTx = lteInfo->getTxNumber();
@@ -147,7 +141,7 @@ bool LteDummyChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lteInf
     return true;
 }
 
-std::tuple<bool, bool> LteDummyChannelModel::error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo,std::vector<double> rsrpVector, std::vector<double> sinrVector, int mcs)
+std::tuple<bool, bool> LteDummyChannelModel::error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, const BandMeasurements& measurements, int mcs)
 {
     // Number of RTX
     unsigned char nTx = lteInfo->getTxNumber();
@@ -8,8 +8,11 @@
 //
 
 #include "stack/phy/ChannelModel/LteRealisticChannelModel.h"
+#include "common/LteDbMath.h"
 #include "stack/phy/packet/LteAirFrame.h"
 #include "corenetwork/binder/LteBinder.h"
+#include "corenetwork/channelstate/ChannelStateManager.h"
+#include "common/CounterRng.h"
 #include "corenetwork/deployer/LteDeployer.h"
 #include "stack/mac/amc/UserTxParams.h"
 #include "common/LteCommon.h"
@@ -145,6 +148,17 @@ LteRealisticChannelModel::LteRealisticChannelModel(ParameterMap& params,
     else
         correlationDistance_ = 50;
 
+    // get the distance after which a D2D link state is recomputed (0 disables the cache)
+    it = params.find("link-state-cache-distance");
+    if (it != params.end())
+    {
+        linkStateCacheDistance_ = it->second.doubleValue();
+        if (linkStateCacheDistance_ < 0)
+            throw cRuntimeError("LteRealisticChannelModel: link-state-cache-distance must not be negative, got %f", linkStateCacheDistance_);
+    }
+    else
+        linkStateCacheDistance_ = 0;
+
     //get Harq reduction
     it = params.find("harqReduction");
     if (it != params.end())
@@ -305,6 +319,32 @@ LteRealisticChannelModel::LteRealisticChannelModel(ParameterMap& params,
     else
         fadingType_ = JAKES;
 
+    //get the nakagami fading settings: RNG reserved to the fading, time and number of
+    //adjacent bands over which a link keeps one realization (0 and 1 draw a new value
+    //for every band of every frame)
+    int nakagamiRng = 0;
+    it = params.find("nakagami-rng");
+    if (it != params.end())
+        nakagamiRng = it->second;
+    double nakagamiCoherenceTime = 0;
+    it = params.find("nakagami-coherence-time");
+    if (it != params.end())
+    {
+        nakagamiCoherenceTime = it->second.doubleValue();
+        if (nakagamiCoherenceTime < 0)
+            throw cRuntimeError("LteRealisticChannelModel: nakagami-coherence-time must not be negative, got %f", nakagamiCoherenceTime);
+    }
+    int nakagamiCoherenceBands = 1;
+    it = params.find("nakagami-coherence-bands");
+    if (it != params.end())
+    {
+        nakagamiCoherenceBands = it->second;
+        if (nakagamiCoherenceBands < 1)
+            throw cRuntimeError("LteRealisticChannelModel: nakagami-coherence-bands must be at least 1, got %d", nakagamiCoherenceBands);
+    }
+    if (fadingType_ == NAKAGAMI)
+        nakagamiSampler_.initialise(shapeFactor_, nakagamiRng, nakagamiCoherenceTime, nakagamiCoherenceBands, 256);
+
     //get number of fading paths for jakes fading
     it = params.find("fading-paths");
     if (it != params.end())
@@ -347,10 +387,30 @@ LteRealisticChannelModel::LteRealisticChannelModel(ParameterMap& params,
     }
     else
         delayRMS_ = 363e-9;
+    //random draws of the channel come from RNG 0, unless a private stream is set
+    rng_ = getEnvir()->getRNG(0);
+
     //get binder
     binder_ = getBinder();
-    //clear jakes fading map structure
-    jakesFadingMap_.clear();
+
+    //refer to the shared channel state, if the network has a manager for it
+    jakesFadingEngine_ = &localState_.jakesFading;
+    sharedState_ = NULL;
+    ChannelStateManager* stateManager = getChannelStateManager();
+    if (stateManager != NULL)
+    {
+        if (correlationDistance_ <= 0)
+            throw cRuntimeError("LteRealisticChannelModel: the shared channel state needs a positive correlation-distance, got %f", correlationDistance_);
+        sharedState_ = stateManager->attach();
+        if (stateManager->getShareJakesFading())
+            jakesFadingEngine_ = &sharedState_->jakesFading;
+    }
+
+    //prepare the jakes fading engine (carrier frequency from GHz to Hz), unless another node already did
+    if (!jakesFadingEngine_->isInitialised())
+        jakesFadingEngine_->initialise(band_, fadingPaths_, carrierFrequency_ * 1000000000);
+    else if (jakesFadingEngine_->getNumBands() != band_ || jakesFadingEngine_->getNumPaths() != fadingPaths_)
+        throw cRuntimeError("LteRealisticChannelModel: the shared jakes fading needs the same number of bands and fading paths on every node");
 }
 
 LteRealisticChannelModel::~LteRealisticChannelModel()
@@ -433,7 +493,7 @@ double LteRealisticChannelModel::getAttenuation(MacNodeId nodeId, Direction dir,
         if (lastComputedSF_.find(nodeId) == lastComputedSF_.end())
         {
             //Get the log normal shadowing with std deviation stdDev
-            att = normal(getEnvir()->getRNG(0), mean, stdDev);
+            att = normal(rng_, mean, stdDev);
 
             //store the shadowing attenuation for this user and the temporal mark
             std::pair<simtime_t, double> tmp(NOW, att);
@@ -459,7 +519,7 @@ double LteRealisticChannelModel::getAttenuation(MacNodeId nodeId, Direction dir,
             double old = lastComputedSF_.at(nodeId).second;
 
             //Compute shadowing with a EAW (Exponential Average Window) (step2)
-            att = a * old + sqrt(1 - pow(a, 2)) * normal(getEnvir()->getRNG(0), mean, stdDev);
+            att = a * old + sqrt(1 - pow(a, 2)) * normal(rng_, mean, stdDev);
 
             // Store the new computed shadowing
             std::pair<simtime_t, double> tmp(NOW, att);
@@ -491,6 +551,11 @@ double LteRealisticChannelModel::getAttenuation(MacNodeId nodeId, Direction dir,
 
 std::tuple<double, double> LteRealisticChannelModel::getAttenuation_D2D(MacNodeId nodeId, Direction dir, Coord coord,MacNodeId node2_Id, Coord coord_2)
 {
+    if (sharedState_ != NULL)
+        return getSharedAttenuation_D2D(nodeId, dir, coord, node2_Id, coord_2);
+    if (linkStateCacheDistance_ > 0)
+        return getCachedAttenuation_D2D(nodeId, dir, coord, node2_Id, coord_2);
+
     double movement = .0;
     double speed = .0;
 
@@ -561,7 +626,7 @@ std::tuple<double, double> LteRealisticChannelModel::getAttenuation_D2D(MacNodeI
         if (lastComputedSF_.find(nodeId) == lastComputedSF_.end())
         {
             //Get the log normal shadowing with std deviation stdDev
-            att = normal(getEnvir()->getRNG(0),mean, stdDev);
+            att = normal(rng_,mean, stdDev);
 
             //store the shadowing attenuation for this user and the temporal mark
             std::pair<simtime_t, double> tmp(NOW, att);
@@ -586,7 +651,7 @@ std::tuple<double, double> LteRealisticChannelModel::getAttenuation_D2D(MacNodeI
             double old = lastComputedSF_.at(nodeId).second;
 
             //Compute shadowing with a EAW (Exponential Average Window) (step2)
-            att = a * old + sqrt(1 - pow(a, 2)) * normal(getEnvir()->getRNG(0),mean, stdDev);
+            att = a * old + sqrt(1 - pow(a, 2)) * normal(rng_,mean, stdDev);
 
             // Store the new computed shadowing
             std::pair<simtime_t, double> tmp(NOW, att);
@@ -618,58 +683,159 @@ std::tuple<double, double> LteRealisticChannelModel::getAttenuation_D2D(MacNodeI
     return std::make_tuple(noShadowingAttenuation, attenuation);
 }
 
-void LteRealisticChannelModel::updatePositionHistory(const MacNodeId nodeId,
-        const Coord coord)
+std::tuple<double, double> LteRealisticChannelModel::getCachedAttenuation_D2D(MacNodeId nodeId, Direction dir, Coord coord,MacNodeId node2_Id, Coord coord_2)
 {
-    if (positionHistory_.find(nodeId) != positionHistory_.end())
+    // the speed of the sender is computed before its position is stored, as in getAttenuation_D2D
+    double speed;
+    //if sender is a eNodeB
+    if (dir == DL)
+    {
+        speed = computeSpeed(nodeId, myCoord_);
+        //store the position of user
+        updatePositionHistory(nodeId, myCoord_);
+    }
+    else
     {
-        // position already updated for this TTI.
-        if (positionHistory_[nodeId].back().first == NOW)
-            return;
+        //sender is an UE
+        speed = computeSpeed(nodeId, coord);
+        updatePositionHistory(nodeId, coord);
     }
 
-    // FIXME: possible memory leak
-    positionHistory_[nodeId].push(Position(NOW, coord));
+    LinkStateMap& linkStates = localState_.linkStates;
+    LinkStateMap::iterator lt = linkStates.find(linkKey(nodeId, node2_Id));
+    bool newLink = (lt == linkStates.end());
+    if (newLink)
+        lt = linkStates.insert(std::make_pair(linkKey(nodeId, node2_Id), LinkState())).first;
+    LinkState& link = lt->second;
 
-    if (positionHistory_[nodeId].size() > 2) // if we have more than a past and a current element
-        // drop the oldest one
-        positionHistory_[nodeId].pop();
-}
+    // distance the sender traveled at its current speed since LOS and shadowing were drawn, as in getAttenuation_D2D.
+    // It also covers a sender whose reported position lags behind its movement
+    double traveled = 0;
+    if (!newLink)
+        traveled = (NOW - link.correlationTime).dbl() * speed;
 
-double LteRealisticChannelModel::computeSpeed(const MacNodeId nodeId,
-        const Coord coord)
-{
-    double speed = 0.0;
+    // neither end moved enough to change the path loss significantly, reuse the stored state
+    if (!newLink && traveled <= correlationDistance_
+        && link.txCoord.distance(coord) <= linkStateCacheDistance_ && link.rxCoord.distance(coord_2) <= linkStateCacheDistance_)
+        return std::make_tuple(link.pathLoss, link.pathLoss + link.shadowing);
 
-    if (positionHistory_.find(nodeId) == positionHistory_.end())
+    double sqrDistance = coord.distance(coord_2);
+
+    // distance traveled by the pair since LOS and shadowing were drawn
+    double space = 0;
+    if (!newLink)
+        space = std::max(link.txCorrelationCoord.distance(coord) + link.rxCorrelationCoord.distance(coord_2), traveled);
+    bool decorrelated = newLink || space > correlationDistance_;
+
+    // the path loss functions read the LOS state of the transmitter from losMap_
+    if (decorrelated)
     {
-        // no entries
-        return speed;
+        computeLosProbability(sqrDistance, nodeId);
+        link.los = losMap_[nodeId];
     }
     else
+        losMap_[nodeId] = link.los;
+
+    double dbp = 0;
+    double attenuation = computeD2DPathLoss(sqrDistance, dbp, nodeId, coord);
+
+    if (!shadowing_)
+        link.shadowing = 0;
+    else if (newLink)
     {
-        //compute distance traveled from last update by UE (eNodeB position is fixed)
+        //Get the log normal shadowing with std deviation according to los/nlos and selected scenario
+        link.shadowing = normal(rng_, 0, getStdDev(sqrDistance < dbp, nodeId));
+    }
+    else if (decorrelated)
+    {
+        //Compute shadowing with a EAW (Exponential Average Window)
+        double a = exp(-0.5 * (space / correlationDistance_));
+        link.shadowing = a * link.shadowing + sqrt(1 - pow(a, 2)) * normal(rng_, 0, getStdDev(sqrDistance < dbp, nodeId));
+    }
 
-        if (positionHistory_[nodeId].size() == 1)
-        {
-            //  the only element refers to present , return 0
-            return speed;
-        }
+    if (decorrelated)
+    {
+        link.txCorrelationCoord = coord;
+        link.rxCorrelationCoord = coord_2;
+        link.correlationTime = NOW;
+    }
+    link.txCoord = coord;
+    link.rxCoord = coord_2;
+    link.pathLoss = attenuation;
 
-        double movement = positionHistory_[nodeId].front().second.distance(coord);
+    EV << "LteRealisticChannelModel::getCachedAttenuation_D2D - computed attenuation at distance " << sqrDistance << " for UE2 is " << attenuation + link.shadowing << endl;
 
-        if (movement <= 0.0)
-            return speed;
-        else
-        {
-            double time = (NOW.dbl()) - (positionHistory_[nodeId].front().first.dbl());
-            if (time <= 0.0) // time not updated since last speed call
-                throw cRuntimeError("Multiple entries detected in position history referring to same time");
-            // compute speed
-            speed = (movement) / (time);
-        }
+    return std::make_tuple(link.pathLoss, link.pathLoss + link.shadowing);
+}
+
+std::tuple<double, double> LteRealisticChannelModel::getSharedAttenuation_D2D(MacNodeId nodeId, Direction dir, Coord coord,MacNodeId node2_Id, Coord coord_2)
+{
+    //if sender is a eNodeB
+    if (dir == DL)
+        //store the position of user
+        updatePositionHistory(nodeId, myCoord_);
+    else
+        //sender is an UE
+        updatePositionHistory(nodeId, coord);
+
+    double sqrDistance = coord.distance(coord_2);
+
+    // LOS and shadowing are drawn from the stream of the link in the correlation cells of its ends,
+    // i.e. they are the same until either end enters another cell, whichever receiver asks
+    uint64_t key = CounterRng::makeKey(sharedState_->linkSeed, linkKey(nodeId, node2_Id));
+    key = CounterRng::makeKey(CounterRng::makeKey(key, correlationCellKey(coord)), correlationCellKey(coord_2));
+    CounterRng linkRng(key);
+    cRNG* rng = rng_;
+    rng_ = &linkRng;
+
+    computeLosProbability(sqrDistance, SHARED_LINK_ID);
+
+    double dbp = 0;
+    double attenuation = computeD2DPathLoss(sqrDistance, dbp, SHARED_LINK_ID, coord);
+
+    //Get the log normal shadowing with std deviation according to los/nlos and selected scenario
+    double shadowing = 0;
+    if (shadowing_)
+        shadowing = normal(rng_, 0, getStdDev(sqrDistance < dbp, SHARED_LINK_ID));
+
+    rng_ = rng;
+
+    EV << "LteRealisticChannelModel::getSharedAttenuation_D2D - computed attenuation at distance " << sqrDistance << " for UE2 is " << attenuation + shadowing << endl;
+
+    return std::make_tuple(attenuation, attenuation + shadowing);
+}
+
+double LteRealisticChannelModel::computeD2DPathLoss(double distance, double& dbp, MacNodeId nodeId, const Coord& coord)
+{
+    switch (scenario_)
+    {
+        case INDOOR_HOTSPOT:
+            return computeIndoor(distance, nodeId);
+        case URBAN_MICROCELL:
+            return computeUrbanMicro(distance, nodeId);
+        case URBAN_MACROCELL:
+            return computeUrbanMacro(distance, nodeId);
+        case RURAL_MACROCELL:
+            return computeRuralMacro(distance, dbp, nodeId);
+        case SUBURBAN_MACROCELL:
+            return computeSubUrbanMacro(distance, dbp, nodeId);
+        case ANALYTICAL:
+            return computeAnalyticalPathloss(coord, myCoord_, nodeId);
+        default:
+            throw cRuntimeError("Wrong value %d for path-loss scenario", scenario_);
     }
-    return speed;
+}
+
+void LteRealisticChannelModel::updatePositionHistory(const MacNodeId nodeId,
+        const Coord coord)
+{
+    binder_->positionHistory.update(nodeId, coord);
+}
+
+double LteRealisticChannelModel::computeSpeed(const MacNodeId nodeId,
+        const Coord coord)
+{
+    return binder_->positionHistory.getSpeed(nodeId, coord);
 }
 
 double computeAngle(Coord center, Coord point) {
@@ -1001,7 +1167,7 @@ std::vector<double> LteRealisticChannelModel::getSINR(LteAirFrame *frame, UserCo
     return snrVector;
 }
 
-std::tuple<std::vector<double>, double> LteRealisticChannelModel::getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord)
+void LteRealisticChannelModel::getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord, BandMeasurements& measurements)
 {
     AttenuationVector::iterator it;
     // Get Tx power
@@ -1022,7 +1188,8 @@ std::tuple<std::vector<double>, double> LteRealisticChannelModel::getRSRP_D2D(Lt
     double speed = 0.0;
     // Get MacId for Ue and his peer
     MacNodeId sourceId = lteInfo_1->getSourceId();
-    std::vector<double> rsrpVector;
+    std::vector<double>& rsrpVector = measurements.rsrpVector;
+    rsrpVector.resize(band_);
 
     // True if we use the jakes map in the UE side (D2D is like DL for the receivers)
     bool cqiDl = false;
@@ -1064,11 +1231,26 @@ std::tuple<std::vector<double>, double> LteRealisticChannelModel::getRSRP_D2D(Lt
     attenuation -= antennaGainTx;
     attenuation -= antennaGainRx;
 
+    // received power per RE (dBm) without attenuation, i.e. the PSD [W/Hz] converted to linear power [W]
+    double txPowerPerRe = linearToDBm(txPowerDensity * 180000.0 / 12.0);
+
     // compute and add interference due to fading
     // Apply fading for each band
     // if the phy layer is localized we can assume that for each logical band we have different fading attenuation
     // if the phy layer is distributed the number of logical band should be set to 1
     double fadingAttenuation = 0;
+
+    // the nakagami mean only depends on the link, so draw the variates of all bands at once
+    double nakagamiScale = 0;
+    if (fading_ && fadingType_ == NAKAGAMI)
+    {
+        nakagamiScale = getNakagamiScale(sourceCoord.distance(destCoord));
+        if (sharedState_ != NULL)
+            nakagamiSampler_.sampleShared(sharedState_->linkSeed, linkKey(sourceId, destId), nakagamiVariates_, band_);
+        else
+            nakagamiSampler_.sample(linkKey(sourceId, destId), nakagamiVariates_, band_);
+    }
+
     //for each logical band
     for (unsigned int i = 0; i < band_; i++)
     {
@@ -1087,33 +1269,28 @@ std::tuple<std::vector<double>, double> LteRealisticChannelModel::getRSRP_D2D(Lt
             }
             else if (fadingType_ == NAKAGAMI)
             {
-                int distance = sourceCoord.distance(destCoord);
-                double pathLossFree = 20*std::log10(distance) + 46.4 + 20*std::log10(carrierFrequency_ * 1e-9 / 5);
-
-                fadingAttenuation = gamma_d(getEnvir()->getRNG(0), shapeFactor_, pathLossFree / 1000.0 / shapeFactor_) * 1000.0;
+                fadingAttenuation = nakagamiScale * nakagamiVariates_[i];
             }
         }
 
         double attenuationFaded = attenuation - fadingAttenuation;
 
-        double attenuationLinear = dBToLinear(-attenuationFaded);
-
-        double rsrp = txPowerDensity * attenuationLinear;
-
-        // Convert PSD [W/Hz] to linear power [W]
-        rsrp = (rsrp) * 180000.0 / 12.0; // convert PSD [W/Hz] to linear power [W]
-
-        rsrp = linearToDBm(rsrp);
-
-        // Store the calculated receive power
-        rsrpVector.push_back(rsrp);
+        // Store the calculated receive power, applying the attenuation in dB avoids a round trip to linear
+        rsrpVector[i] = txPowerPerRe - attenuationFaded;
     }
     //============ END PATH LOSS + SHADOWING + FADING ===============
 
-    return std::make_tuple(rsrpVector, noShadowingAttenuation);
+    measurements.attenuation = noShadowingAttenuation;
 }
 
 std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo, MacNodeId destId, Coord destCoord, MacNodeId enbId)
+{
+    std::vector<double> snrVector;
+    computeUnicastSINR_D2D(lteInfo, destId, destCoord, enbId, snrVector);
+    return snrVector;
+}
+
+void LteRealisticChannelModel::computeUnicastSINR_D2D(UserControlInfo* lteInfo, MacNodeId destId, Coord destCoord, MacNodeId enbId, std::vector<double>& snrVector)
 {
     AttenuationVector::iterator it;
     // Get Tx power
@@ -1129,7 +1306,8 @@ std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, Us
     double extCellInterference = 0;
     // Get MacId for Ue and his peer
     MacNodeId sourceId = lteInfo->getSourceId();
-    std::vector<double> snrVector;
+    // filled in place, so no allocation happens once snrVector has been sized
+    snrVector.clear();
 
     // True if we use the jakes map in the UE side (D2D is like DL for the receivers)
     bool cqiDl = false;
@@ -1257,9 +1435,9 @@ std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, Us
      * is so we swap the ueId with the one of his Peer(D2D_Rx). We do the same for the coord.
      */
     //vector containing the sum of inCell interference for each band
-    std::vector<double> inCellInterference; // Linear value (mW)
+    std::vector<double>& inCellInterference = inCellInterference_; // Linear value (mW)
     // prepare data structure
-    inCellInterference.resize(band_, 0);
+    inCellInterference.assign(band_, 0);
     if (enableD2DInCellInterference_ && dir == D2D)
     {
         // TODO this function must be implemented
@@ -1307,13 +1485,18 @@ std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, Us
     }
     //sender is an UE
     updatePositionHistory(sourceId, sourceCoord);
+}
 
+std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord,MacNodeId enbId,const std::vector<double>& rsrpVector, bool interference=true)
+{
+    std::vector<double> snrVector;
+    computeSINR_D2D(lteInfo_1, destId, destCoord, enbId, rsrpVector, interference, snrVector);
     return snrVector;
 }
 
-std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector, bool interference=true)
+void LteRealisticChannelModel::computeSINR_D2D(UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord, MacNodeId enbId, const std::vector<double>& rsrpVector, bool interference, std::vector<double>& snrVector)
 {
-    std::vector<double> snrVector = rsrpVector;
+    snrVector = rsrpVector;
 
     MacNodeId sourceId = lteInfo_1->getSourceId();
     Coord sourceCoord = lteInfo_1->getCoord();
@@ -1358,9 +1541,9 @@ std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, Us
      * is so we swap the ueId with the one of his Peer(D2D_Rx). We do the same for the coord.
      */
     //vector containing the sum of inCell interference for each band
-    std::vector<double> inCellInterference; // Linear value (mW)
+    std::vector<double>& inCellInterference = inCellInterference_; // Linear value (mW)
     // prepare data structure
-    inCellInterference.resize(band_, 0);
+    inCellInterference.assign(band_, 0);
 
     if (interference && enableD2DInCellInterference_ && dir == D2D) {
         computeInCellD2DInterference(enbId, sourceId, sourceCoord, destId, destCoord,
@@ -1377,10 +1560,16 @@ std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, Us
         EV << "LteRealisticChannelModel::getSINR - distance from my Peer = " << destCoord.distance(sourceCoord)
            << " - DIR=" << dirToA(dir) << endl;
 
+        //                       (      mW            +  mW  +        mW            )
+        std::vector<double>& denominator = denominatorBuffer_;
+        denominator.resize(band_);
+        for (unsigned int i = 0; i < band_; i++)
+            denominator[i] = extCellInterference + totN + inCellInterference[i];
+        linearToDBm(denominator.data(), denominator.data(), band_);
+
         // Add interference for each band
         for (unsigned int i = 0; i < band_; i++) {
-            //               (      mW            +  mW  +        mW            )
-            den = linearToDBm(extCellInterference + totN + inCellInterference[i]);
+            den = denominator[i];
 
             EV << "\t ext[" << extCellInterference << "] - in[" << inCellInterference[i] << "] - recvPwr["
                << dBmToLinear(snrVector[i]) << "] - sinr[" << snrVector[i] - den << "]\n";
@@ -1392,37 +1581,33 @@ std::vector<double> LteRealisticChannelModel::getSINR_D2D(LteAirFrame *frame, Us
     // compute snr with no incellD2D interference
     else
     {
-        for (unsigned int i = 0; i < band_; i++)
-        {
-            {
-                // compute final SINR
-                double thermalNoiseLinear = std::pow (10.0, (thermalNoise_ - 30) / 10.0);
-                double noiseFigureLinear = std::pow (10.0, ueNoiseFigure_ / 10.0);
-                double noisePowerSpectralDensity =  thermalNoiseLinear * noiseFigureLinear;
-
-                double rsrpPerReLinear = dBmToLinear(rsrpVector[i]);
+        double thermalNoiseLinear = std::pow (10.0, (thermalNoise_ - 30) / 10.0);
+        double noiseFigureLinear = std::pow (10.0, ueNoiseFigure_ / 10.0);
+        double noisePowerSpectralDensity =  thermalNoiseLinear * noiseFigureLinear;
 
-                double denSinr = (noisePowerSpectralDensity * 180000.0)/12;
-                denSinr = rsrpPerReLinear / denSinr;
+        // noise power per RE, in dBm
+        double noisePerRe = linearToDBm((noisePowerSpectralDensity * 180000.0)/12);
 
-                // compute final SINR
-                snrVector[i] = linearToDb(denSinr);
+        for (unsigned int i = 0; i < band_; i++)
+        {
+            // compute final SINR. Subtraction in dB is equivalent to linear division
+            snrVector[i] = rsrpVector[i] - noisePerRe;
 
-                EV << "LteRealisticChannelModel::getSINR_D2D - distance from my Peer = " << destCoord.distance(sourceCoord) << " - DIR=" << dirToA(dir) << " - snr[" << snrVector[i] << "]\n";
-            }
+            EV << "LteRealisticChannelModel::getSINR_D2D - distance from my Peer = " << destCoord.distance(sourceCoord) << " - DIR=" << dirToA(dir) << " - snr[" << snrVector[i] << "]\n";
         }
     }
 
     //sender is a UE
     updatePositionHistory(sourceId, sourceCoord);
-
-    return snrVector;
 }
 
-std::tuple<std::vector<double>, std::vector<double>> LteRealisticChannelModel::getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector)
+void LteRealisticChannelModel::getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, Coord destCoord,MacNodeId enbId, BandMeasurements& measurements)
 {
-    std::vector<double> rssiVector = rsrpVector;
-    std::vector<double> snrVector = rsrpVector;
+    // copied in place, so no allocation happens once the measurement record has been sized
+    std::vector<double>& rssiVector = measurements.rssiVector;
+    std::vector<double>& snrVector = measurements.sinrVector;
+    rssiVector = measurements.rsrpVector;
+    snrVector = measurements.rsrpVector;
 
     MacNodeId sourceId = lteInfo_1->getSourceId();
     Coord sourceCoord = lteInfo_1->getCoord();
@@ -1475,9 +1660,9 @@ std::tuple<std::vector<double>, std::vector<double>> LteRealisticChannelModel::g
      * is so we swap the ueId with the one of his Peer(D2D_Rx). We do the same for the coord.
      */
     //vector containing the sum of inCell interference for each band
-    std::vector<double> inCellInterference; // Linear value (mW)
+    std::vector<double>& inCellInterference = inCellInterference_; // Linear value (mW)
     // prepare data structure
-    inCellInterference.resize(band_, 0);
+    inCellInterference.assign(band_, 0);
     if (enableD2DInCellInterference_ && dir == D2D)
     {
         computeInCellD2DInterference(enbId, sourceId, sourceCoord, destId, destCoord, (lteInfo_1->getFrameType() == FEEDBACKPKT), &inCellInterference,dir);
@@ -1498,31 +1683,30 @@ std::tuple<std::vector<double>, std::vector<double>> LteRealisticChannelModel::g
         double denSinr;
         EV << "LteRealisticChannelModel::getSINR - distance from my Peer = " << destCoord.distance(sourceCoord) << " - DIR=" << dirToA(dir)  << endl;
 
-        // Add interference for each band
+        std::vector<double>& rsrpPerReLinear = linearBuffer_;
+        rsrpPerReLinear.resize(band_);
+        dBmToLinear(rssiVector.data(), rsrpPerReLinear.data(), band_);
+
+        // Add interference for each band, all values stay linear until the final batch conversions
         for (unsigned int i = 0; i < band_; i++)
         {
             //        (        mW               +        mW            )
-            double interference = linearToDBm(inCellInterference[i]);
             denRssi = noisePowerSpectralDensity + inCellInterference[i];
             // Convert PSD [W/Hz] to linear power [W] for the single RE
             denRssi = (denRssi * 180000.0) / 12.0;
 
-            double rsrpPerReLinear = dBmToLinear(rssiVector[i]);
-
-            double linearRSSI = 12 * (denRssi + rsrpPerReLinear);
-            double rssi = linearToDBm(linearRSSI);
-
-            rssiVector[i] = rssi;
+            rssiVector[i] = 12 * (denRssi + rsrpPerReLinear[i]);
 
             //        (      mW                  +        mW            )
             denSinr = noisePowerSpectralDensity + inCellInterference[i];
 
             denSinr = (denSinr * 180000.0)/12;
-            denSinr = rsrpPerReLinear / denSinr;
-
-            // compute final SINR
-            snrVector[i] = linearToDb(denSinr);
+            snrVector[i] = rsrpPerReLinear[i] / denSinr;
         }
+        linearToDBm(rssiVector.data(), rssiVector.data(), band_);
+
+        // compute final SINR
+        linearToDb(snrVector.data(), snrVector.data(), band_);
     }
         // compute rssi with no incellD2D interference
     else
@@ -1541,8 +1725,6 @@ std::tuple<std::vector<double>, std::vector<double>> LteRealisticChannelModel::g
 
     //sender is a UE
     updatePositionHistory(sourceId, sourceCoord);
-
-    return std::make_tuple(rssiVector, snrVector);
 }
 
 std::vector<double> LteRealisticChannelModel::getSIR(LteAirFrame *frame,
@@ -1654,83 +1836,59 @@ double LteRealisticChannelModel::jakesFading(MacNodeId nodeId, double speed,
      *
      * thus the actual map should be choosen carefully (i.e. just check the cqiDL flag)
      */
-    JakesFadingMap * actualJakesMap;
+    JakesFadingEngine * actualJakesEngine;
 
     if (cqiDl) // if we are computing a DL CQI we need the Jakes Map stored on the UE side
-        actualJakesMap = obtainUeJakesMap(nodeId);
+        actualJakesEngine = obtainUeJakesEngine(nodeId);
 
     else
-        actualJakesMap = &jakesFadingMap_;
+        actualJakesEngine = jakesFadingEngine_;
+
+    // convert carrier frequency from GHz to Hz
+    double f = carrierFrequency_ * 1000000000;
+
+    //get transmission time start (TTI =1ms)
+    simtime_t t = simTime().dbl() - 0.001;
+
+    // Compute Doppler shift.
+    double doppler_shift = (speed * f) / SPEED_OF_LIGHT;
 
     //if this is the first time that we compute fading for current user
-    if (actualJakesMap->find(nodeId) == actualJakesMap->end())
+    if (!actualJakesEngine->hasNode(nodeId))
     {
-        //clear the map
-        // FIXME: possible memory leak
-        (*actualJakesMap)[nodeId].clear();
+        std::vector<double> angleOfArrival;
+        std::vector<double> delaySpread;
 
         //for each band we are going to create a jakes fading
         for (unsigned int j = 0; j < band_; j++)
         {
-            //clear some structure
-            JakesFadingData temp;
-            temp.angleOfArrival.clear();
-            temp.delaySpread.clear();
-
             //for each fading path
             for (int i = 0; i < fadingPaths_; i++)
             {
                 //get angle of arrivals
-                temp.angleOfArrival.push_back(cos(uniform(getEnvir()->getRNG(0),0, M_PI)));
+                angleOfArrival.push_back(cos(uniform(rng_,0, M_PI)));
 
                 //get delay spread
-                temp.delaySpread.push_back(exponential(getEnvir()->getRNG(0),delayRMS_));
+                delaySpread.push_back(simtime_t(exponential(rng_,delayRMS_)).dbl());
             }
-            //store the jakes fadint for this user
-            (*actualJakesMap)[nodeId].push_back(temp);
         }
+        //store the jakes fading for this user
+        actualJakesEngine->addNode(nodeId, angleOfArrival, delaySpread);
     }
-    // convert carrier frequency from GHz to Hz
-    double f = carrierFrequency_ * 1000000000;
-
-    //get transmission time start (TTI =1ms)
-    simtime_t t = simTime().dbl() - 0.001;
-
-    double re_h = 0;
-    double im_h = 0;
-
-    // Compute Doppler shift.
-    double doppler_shift = (speed * f) / SPEED_OF_LIGHT;
 
-    for (int i = 0; i < fadingPaths_; i++)
-    {
-        // Phase shift due to Doppler => t-selectivity.
-        double phi_d = actualJakesMap->at(nodeId).at(band).angleOfArrival[i] * doppler_shift;
-
-        // Phase shift due to delay spread => f-selectivity.
-        double phi_i = actualJakesMap->at(nodeId).at(band).delaySpread[i].dbl() * f;
-
-        // Calculate resulting phase due to t-selective and f-selective fading.
-        double phi = 2.00 * M_PI * (phi_d * t.dbl() - phi_i);
-
-        // One ring model/Clarke's model plus f-selectivity according to Cavers:
-        // Due to isotropic antenna gain pattern on all paths only a^2 can be received on all paths.
-        // Since we are interested in attenuation a:=1, attenuation per path is then:
-        double attenuation = (1.00 / sqrt(static_cast<double>(fadingPaths_)));
-
-        // Convert to cartesian form and aggregate {Re, Im} over all fading paths.
-        re_h = re_h + attenuation * cos(phi);
-        im_h = im_h - attenuation * sin(phi);
+    // Output: |H_f|^2 = absolute channel impulse response due to fading.
+    // All bands are computed at once, the other bands of this TTI are then a lookup
+    return actualJakesEngine->getFading(nodeId, band, doppler_shift, t);
+}
 
-        //        EV << "ID=" << nodeId << " - t[" << t << "] - dopplerShift[" << doppler_shift << "] - phiD[" <<
-        //                phi_d << "] - phiI[" << phi_i << "] - phi[" << phi << "] - attenuation[" << attenuation << "] - f["
-        //                << f << "] - Band[" << band << "] - cos(phi)["
-        //                << cos(phi) << "]" << endl;
-    }
+void LteRealisticChannelModel::prepareJakesFading_D2D(MacNodeId sourceId, const Coord& sourceCoord)
+{
+    if (!fading_ || fadingType_ != JAKES)
+        return;
 
-    // Output: |H_f|^2 = absolute channel impulse response due to fading.
-    // Note that this may be >1 due to constructive interference.
-    return linearToDb(re_h * re_h + im_h * im_h);
+    // as getRSRP_D2D: jakes map on the UE side, speed of the transmitter.
+    // All the bands are computed at once
+    jakesFading(sourceId, computeSpeed(sourceId, sourceCoord), 0, true);
 }
 
 double LteRealisticChannelModel::computeAnalyticalPathloss(Coord destCoord, Coord sourceCoord, MacNodeId)
@@ -1817,13 +1975,13 @@ bool LteRealisticChannelModel::error(LteAirFrame *frame,
     }
 
     // Take sinr
-    std::vector<double> snrV;
+    std::vector<double>& snrV = snrBuffer_;
     if (lteInfo->getDirection() == D2D || lteInfo->getDirection() == D2D_MULTI)
     {
         MacNodeId destId = lteInfo->getDestId();
         Coord destCoord = myCoord_;
         MacNodeId enbId = binder_->getNextHop(lteInfo->getSourceId());
-        snrV = getSINR_D2D(frame,lteInfo,destId,destCoord,enbId);
+        computeUnicastSINR_D2D(lteInfo,destId,destCoord,enbId,snrV);
     }
     else
     {
@@ -1831,7 +1989,7 @@ bool LteRealisticChannelModel::error(LteAirFrame *frame,
     }
 
     //Get the resource Block id used to transmit this packet
-    RbMap rbmap = lteInfo->getGrantedBlocks();
+    const RbMap& rbmap = lteInfo->getGrantedBlocks();
 
     //Get txmode
     unsigned int itxmode = txModeToIndex[txmode];
@@ -1839,8 +1997,8 @@ bool LteRealisticChannelModel::error(LteAirFrame *frame,
     double bler = 0;
     std::vector<double> totalbler;
     double finalSuccess = 1;
-    RbMap::iterator it;
-    std::map<Band, unsigned int>::iterator jt;
+    RbMap::const_iterator it;
+    std::map<Band, unsigned int>::const_iterator jt;
 
     //for each Remote unit used to transmit the packet
     for (it = rbmap.begin(); it != rbmap.end(); ++it)
@@ -1892,7 +2050,7 @@ bool LteRealisticChannelModel::error(LteAirFrame *frame,
     //Harq Reduction
     double totalPer = per * pow(harqReduction_, nTx - 1);
 
-    double er = uniform(getEnvir()->getRNG(0), 0.0, 1.0);
+    double er = uniform(rng_, 0.0, 1.0);
 
     EV << " LteRealisticChannelModel::error direction " << dirToA(dir)
                        << " node " << id << " total ERROR probability  " << per
@@ -1912,7 +2070,7 @@ bool LteRealisticChannelModel::error(LteAirFrame *frame,
     return true;
 }
 
-bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lteInfo, std::vector<double> rsrpVector)
+bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lteInfo, const std::vector<double>& rsrpVector)
 {
     EV << "LteRealisticChannelModel::error_D2D" << endl;
 
@@ -1961,7 +2119,7 @@ bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lt
             return false;
     }
     // SINR vector(one SINR value for each band)
-    std::vector<double> snrV;
+    std::vector<double>& snrV = snrBuffer_;
     if (lteInfo->getDirection() == D2D || lteInfo->getDirection() == D2D_MULTI)
     {
         MacNodeId peerUeMacNodeId = lteInfo->getDestId();
@@ -1971,18 +2129,18 @@ bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lt
 
         if (lteInfo->getDirection() == D2D)
         {
-            snrV = getSINR_D2D(frame,lteInfo,peerUeMacNodeId,peerCoord,enbId);
+            computeUnicastSINR_D2D(lteInfo,peerUeMacNodeId,peerCoord,enbId,snrV);
         }
         else  // D2D_MULTI
         {
-            snrV = getSINR_D2D(frame,lteInfo,peerUeMacNodeId,peerCoord,enbId,rsrpVector, true);
+            computeSINR_D2D(lteInfo,peerUeMacNodeId,peerCoord,enbId,rsrpVector,true,snrV);
         }
     }
     //ROSSALI-------END------------------------------------------------
     else  snrV = getSINR(frame, lteInfo); // Take SINR
 
     //Get the resource Block id used to transmit this packet
-    RbMap rbmap = lteInfo->getGrantedBlocks();
+    const RbMap& rbmap = lteInfo->getGrantedBlocks();
 
     //Get txmode
     unsigned int itxmode = txModeToIndex[txmode];
@@ -1990,8 +2148,8 @@ bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lt
     double bler = 0;
     std::vector<double> totalbler;
     double finalSuccess = 1;
-    RbMap::iterator it;
-    std::map<Band, unsigned int>::iterator jt;
+    RbMap::const_iterator it;
+    std::map<Band, unsigned int>::const_iterator jt;
 
     //for each Remote unit used to transmit the packet
     for (it = rbmap.begin(); it != rbmap.end(); ++it)
@@ -2042,7 +2200,7 @@ bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lt
     // Harq Reduction
     double totalPer = per * pow(harqReduction_, nTx - 1);
 
-    double er = uniform(getEnvir()->getRNG(0),0.0, 1.0);
+    double er = uniform(rng_,0.0, 1.0);
 
     EV << " LteRealisticChannelModel::error direction " << dirToA(dir)
        << " node " << id << " total ERROR probability  " << per
@@ -2061,8 +2219,11 @@ bool LteRealisticChannelModel::error_D2D(LteAirFrame *frame, UserControlInfo* lt
     return true;
 }
 
-std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, std::vector<double> rsrpVector, std::vector<double> sinrVector, int mcs)
+std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, const BandMeasurements& measurements, int mcs)
 {
+    const std::vector<double>& rsrpVector = measurements.rsrpVector;
+    const std::vector<double>& sinrVector = measurements.sinrVector;
+
     EV << "LteRealisticChannelModel::error_Mode4" << endl;
 
     //get codeword
@@ -2111,7 +2272,7 @@ std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame,
     }
 
     // SNR vector(one SNR value for each band)
-    std::vector<double> snrV;
+    std::vector<double>& snrV = snrBuffer_;
     if (lteInfo->getDirection() == D2D || lteInfo->getDirection() == D2D_MULTI) {
         MacNodeId peerUeMacNodeId = lteInfo->getDestId();
         Coord peerCoord = myCoord_;
@@ -2119,10 +2280,10 @@ std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame,
         MacNodeId enbId = 1;
 
         if (lteInfo->getDirection() == D2D) {
-            snrV = getSINR_D2D(frame, lteInfo, peerUeMacNodeId, peerCoord, enbId);
+            computeUnicastSINR_D2D(lteInfo, peerUeMacNodeId, peerCoord, enbId, snrV);
         } else  // D2D_MULTI
         {
-            snrV = getSINR_D2D(frame, lteInfo, peerUeMacNodeId, peerCoord, enbId, rsrpVector, false);
+            computeSINR_D2D(lteInfo, peerUeMacNodeId, peerCoord, enbId, rsrpVector, false, snrV);
         }
     }
 
@@ -2132,9 +2293,15 @@ std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame,
     double averageSinr = 0;
     double countUsedRbs = 0;
 
-    RbMap rbmap = lteInfo->getGrantedBlocks();
-    RbMap::iterator it;
-    std::map<Band, unsigned int>::iterator jt;
+    const RbMap& rbmap = lteInfo->getGrantedBlocks();
+    RbMap::const_iterator it;
+    std::map<Band, unsigned int>::const_iterator jt;
+
+    // gather the SNR and SINR of the used bands, so that they are linearized in one batch
+    std::vector<double>& usedSnr = linearBuffer_;
+    std::vector<double>& usedSinr = denominatorBuffer_;
+    usedSnr.clear();
+    usedSinr.clear();
 
     //for each Remote unit used to transmit the packet
     for (it = rbmap.begin(); it != rbmap.end(); ++it) {
@@ -2150,49 +2317,29 @@ std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame,
                 //we consider only the snr associated to the LB used
                 if (it->first != lteInfo->getCw()) continue;
 
-            //Get the Bler
-            averageSnr += dBToLinear(snrV[jt->first]);
-            averageSinr += dBToLinear(sinrVector[jt->first]);
-            countUsedRbs += 1;
+            usedSnr.push_back(snrV[jt->first]);
+            usedSinr.push_back(sinrVector[jt->first]);
         }
     }
 
+    //Get the Bler
+    unsigned int numUsedRbs = usedSnr.size();
+    dBToLinear(usedSnr.data(), usedSnr.data(), numUsedRbs);
+    dBToLinear(usedSinr.data(), usedSinr.data(), numUsedRbs);
+    for (unsigned int i = 0; i < numUsedRbs; i++) {
+        averageSnr += usedSnr[i];
+        averageSinr += usedSinr[i];
+        countUsedRbs += 1;
+    }
+
     averageSnr = linearToDb(averageSnr/countUsedRbs);
     averageSinr = linearToDb(averageSinr/countUsedRbs);
 
-    if (averageSnr > binder_->phyPisaData.maxSnr())
-        blerSnr = 0;
-    else
-    if (lteInfo->getFrameType() == SCIPKT)
-    {
-        // TODO: Make this slightly tidier.
-        blerSnr = binder_->phyPisaData.GetPscchBler(binder_->phyPisaData.AWGN, binder_->phyPisaData.SISO, averageSnr);
-    }
-    else
-    {
-        if (analytical_)
-            blerSnr = binder_->phyPisaData.GetBlerAnalytical(mcs, averageSnr);
-        else
-            blerSnr = binder_->phyPisaData.GetPsschBler(binder_->phyPisaData.AWGN, binder_->phyPisaData.SISO, mcs, averageSnr);
-    }
-
-    if (averageSinr > binder_->phyPisaData.maxSnr())
-        blerSinr = 0;
-    else
-    if (lteInfo->getFrameType() == SCIPKT)
-    {
-        // TODO: Make this slightly tidier.
-        blerSinr = binder_->phyPisaData.GetPscchBler(binder_->phyPisaData.AWGN, binder_->phyPisaData.SISO, averageSinr);
-    }
-    else
-    {
-        if (analytical_)
-            blerSinr = binder_->phyPisaData.GetBlerAnalytical(mcs, averageSinr);
-        else
-            blerSinr = binder_->phyPisaData.GetPsschBler(binder_->phyPisaData.AWGN, binder_->phyPisaData.SISO, mcs, averageSinr);
-    }
+    bool sci = (lteInfo->getFrameType() == SCIPKT);
+    blerSnr = getSidelinkBler(sci, mcs, averageSnr);
+    blerSinr = getSidelinkBler(sci, mcs, averageSinr);
 
-    double er = uniform(getEnvir()->getRNG(0),0.0, 1.0);
+    double er = uniform(rng_,0.0, 1.0);
 
     bool resultSnr = true;
     bool resultSinr = true;
@@ -2211,6 +2358,27 @@ std::tuple<bool, bool> LteRealisticChannelModel::error_Mode4(LteAirFrame *frame,
     return std::make_tuple(resultSnr, resultSinr);
 }
 
+double LteRealisticChannelModel::getSidelinkBler(bool sci, int mcs, double sinr)
+{
+    if (sinr > binder_->phyPisaData.maxSnr())
+        return 0;
+    if (sci)
+        return binder_->phyPisaData.LookupPscchBler(sinr);
+    if (analytical_)
+        return binder_->phyPisaData.GetBlerAnalytical(mcs, sinr);
+    return binder_->phyPisaData.LookupPsschBler(mcs, sinr);
+}
+
+double LteRealisticChannelModel::getNakagamiScale(double distance)
+{
+    // the free space path loss is evaluated at the integer distance
+    int meters = distance;
+    double pathLossFree = 20*std::log10(meters) + 46.4 + 20*std::log10(carrierFrequency_ * 1e-9 / 5);
+
+    // Gamma(k, m/k) is m/k times Gamma(k, 1)
+    return pathLossFree / shapeFactor_;
+}
+
 void LteRealisticChannelModel::computeLosProbability(double d,
         MacNodeId nodeId)
 {
@@ -2253,7 +2421,7 @@ void LteRealisticChannelModel::computeLosProbability(double d,
     default:
         throw cRuntimeError("Wrong path-loss scenario value %d", scenario_);
     }
-    double random = uniform(getEnvir()->getRNG(0), 0.0, 1.0);
+    double random = uniform(rng_, 0.0, 1.0);
     if (random <= p)
         losMap_[nodeId] = true;
     else
@@ -2646,15 +2814,15 @@ double LteRealisticChannelModel::computeExtCellPathLoss(double dist, MacNodeId n
     return attenuation;
 }
 
-LteRealisticChannelModel::JakesFadingMap * LteRealisticChannelModel::obtainUeJakesMap(MacNodeId id)
+JakesFadingEngine * LteRealisticChannelModel::obtainUeJakesEngine(MacNodeId id)
 {
     // obtain a reference to UE phy
     LtePhyBase * ltePhy = check_and_cast<LtePhyBase*>(
             getSimulation()->getModule(binder_->getOmnetId(id))->getSubmodule("lteNic")->getSubmodule("phy"));
 
-    // get the associated channel and get a reference to its Jakes Map
+    // get the associated channel and get a reference to its Jakes engine
     LteRealisticChannelModel * re = dynamic_cast<LteRealisticChannelModel *>(ltePhy->getChannelModel());
-    JakesFadingMap * j = re->getJakesMap();
+    JakesFadingEngine * j = re->getJakesEngine();
 
     return j;
 }
@@ -2773,7 +2941,6 @@ bool LteRealisticChannelModel::computeInCellD2DInterference(MacNodeId eNbId, Mac
     // Reference to the Physical Channel  of the Interfering UE
     LtePhyBase * ltePhy;
 
-    int temp;
     double att;
     double txPwr;
     // Vector that report if a band must be excluded or not
@@ -2782,72 +2949,54 @@ bool LteRealisticChannelModel::computeInCellD2DInterference(MacNodeId eNbId, Mac
 
     EV<<NOW<<"ComputeInCellD2DInterference for Node: "<<destId<<endl;
 
-    // Get the list of all UEs
-    std::vector<UeInfo*> * ueList = binder_->getUeList();
-    std::vector<UeInfo*>::iterator it = ueList->begin(), et = ueList->end();
+    // if we are computing feedback, consider the UEs transmitting in this TTI
+    // if we are decoding a transmission, consider the UEs that transmitted in the previous TTI
+    simtime_t tti = (isCqi) ? NOW : NOW - TTI;
 
-    // For all the UEs
-    for(;it!=et;it++)
-    {
-        //Get the id of the interfering node
-        MacNodeId interferringId = (*it)->id;
+    // Get the UEs that transmitted in the given TTI in the grid cells around the receiver (sorted as the UE list)
+    binder_->getActiveTransmittersInRange(tti, destCoord, 1500, interferers_);
+    std::vector<const ActiveTransmitter*>::const_iterator jt = interferers_.begin(), et = interferers_.end();
 
-        // initialize UE data structures
-        if(!(*it)->init)
-        {
-            // get real Channel
-            (*it)->realChan = dynamic_cast<LteRealisticChannelModel *>((*it)->phy->getChannelModel());
+    // For all the transmitters
+    for(;jt!=et;jt++)
+    {
+        const ActiveTransmitter* it = *jt;
 
-            (*it)->init = true;
-        }
-        ltePhy = (*it)->phy;
+        //Get the id of the interfering node
+        MacNodeId interferringId = it->id;
+        ltePhy = it->phy;
 
-        if (isCqi && ltePhy->getLastActive() != NOW)  // if we are computing feedback and the interfering UE has not transmitted in this TTI, skip
-            continue;
-        if (!isCqi && ltePhy->getLastActive() != NOW - TTI)  // if we are decoding a transmission and the interfering UE has not transmitted in the previous TTI, skip
+        // skip UEs that transmitted again after the given TTI
+        if (ltePhy->getLastActive() != tti)
             continue;
 
         // Skip Self-Interference and useful signal
         if (interferringId == destId || interferringId == senderId)
             continue;
 
-        if (destCoord.distance(ltePhy->getCoord()) > 1500)
+        if (destCoord.distance(it->coord) > 1500)
             continue;
 
         EV<<NOW<<" ComputeInCellD2DInterference.Interference from Node: "<<interferringId<<endl;
 
         // Compute attenuation using data structures within the Macro Cell.
-        std::tuple<double, double> attenuations = getAttenuation_D2D(interferringId, dir, ltePhy->getCoord(), destId, destCoord); // dB
+        std::tuple<double, double> attenuations = getAttenuation_D2D(interferringId, dir, it->coord, destId, destCoord); // dB
         att = get<1>(attenuations);
 
-        // The antenna set in computeTxParams is always "MACRO". Here create a fake set with MACRO as the only element
-        std::set<Remote> antennas;
-        antennas.insert(MACRO);
-        std::set<Remote>::const_iterator antenna_it = antennas.begin();
-        std::set<Remote>::const_iterator antenna_et = antennas.end();
-
-        double usedRbCount = 0.0;
-
-        for (antenna_it = antennas.begin(); antenna_it != antenna_et; ++antenna_it)
-        {
-            usedRbCount = check_and_cast<LtePhyUe*>(ltePhy)->getPrevUsedNumberOfRbs(*antenna_it, band_);
-        }
+        // The antenna set in computeTxParams is always "MACRO", which is the only one stored in the list
+        double usedRbCount = it->usedBandCount;
 
-        // CQI computation. We need to check the slot occupation of the actual TTI
         if(isCqi)
         {
-            // For each band we have to check if the Band is occupied by the interferringId
+            // CQI computation. We need to check the slot occupation of the actual TTI
+            txPwr = it->txPwr;
             for(unsigned int i=0;i<band_;i++)
             {
-                for (antenna_it = antennas.begin(); antenna_it != antenna_et; ++antenna_it)
+                // Compute interference only if the band is occupied by an Interfering Node
+                if (it->usedBands[i])
                 {
-                    temp = check_and_cast<LtePhyUe*>(ltePhy)->getUsedRbs(*antenna_it, i);
-                    // Compute interference only if the band is occupied by an Interfering Node
-                    if( temp!=0 )
-                    {
-                        // Add the interference
-                        (*interference)[i] += dBmToLinear(txPwr-att);
-                    }
+                    // Add the interference
+                    (*interference)[i] += dBmToLinear(txPwr-att);
                 }
             }
         }
@@ -2856,20 +3005,16 @@ bool LteRealisticChannelModel::computeInCellD2DInterference(MacNodeId eNbId, Mac
             // For each band we have to check if the Band in the previous TTI was occupied by the interferringId
             for(unsigned int i=0;i<band_;i++)
             {
-                for (antenna_it = antennas.begin(); antenna_it != antenna_et; ++antenna_it)
+                // Compute interference only if the band was occupied by an interfering Node
+                if (it->usedBands[i])
                 {
-                    temp = check_and_cast<LtePhyUe*>(ltePhy)->getPrevUsedRbs(*antenna_it, i);
-                    // Compute interference only if the band was occupied by an interfering Node
-                    if( temp!=0 )
-                    {
-                        // log this band
-                        double recvPower = ltePhy->getTxPwr(dir) + 2 * antennaGainUe_; // dBm
-                        double recvPowLinear = dBmToLinear(recvPower-att);
-                        double interferencePSD = (recvPowLinear / (usedRbCount * 180000));
-
-                        // Add the interference
-                        (*interference)[i] += interferencePSD;
-                    }
+                    // log this band
+                    double recvPower = it->txPwr + 2 * antennaGainUe_; // dBm
+                    double recvPowLinear = dBmToLinear(recvPower-att);
+                    double interferencePSD = (recvPowLinear / (usedRbCount * 180000));
+
+                    // Add the interference
+                    (*interference)[i] += interferencePSD;
                 }
             }
         }
@@ -10,7 +10,10 @@
 #ifndef _LTE_LTEREALISTICCHANNELMODEL_H_
 #define _LTE_LTEREALISTICCHANNELMODEL_H_
 
+#include <unordered_map>
 #include "stack/phy/ChannelModel/LteChannelModel.h"
+#include "stack/phy/ChannelModel/ChannelState.h"
+#include "stack/phy/ChannelModel/NakagamiFadingSampler.h"
 #include "inet/physicallayer/pathloss/NakagamiFading.h"
 
 class LteBinder;
@@ -21,7 +24,7 @@ class LteBinder;
  */
 class LteRealisticChannelModel : public LteChannelModel
 {
-  private:
+  protected:
     // Determines if this is an analytical model or not
     bool analytical_;
 
@@ -54,11 +57,6 @@ class LteRealisticChannelModel : public LteChannelModel
     bool enableMultiCellInterference_;
     bool enableD2DInCellInterference_;
 
-    typedef std::pair<simtime_t, inet::Coord> Position;
-
-    // last position of current user
-    std::map<MacNodeId, std::queue<Position> > positionHistory_;
-
     // scenario
     DeploymentScenario scenario_;
 
@@ -72,6 +70,31 @@ class LteRealisticChannelModel : public LteChannelModel
     //also used to recompute the probability of LOS
     double correlationDistance_;
 
+    // state owned by this channel model, used for what is not shared by a ChannelStateManager
+    ChannelState localState_;
+
+    // state of the ChannelStateManager, NULL if the network has none
+    ChannelState* sharedState_;
+
+    // losMap_ entry the path loss functions read for links derived from the shared state (not a valid node id)
+    static const MacNodeId SHARED_LINK_ID = 0;
+
+    // distance (m) either end of a link may move before its path loss is recomputed, 0 disables the link state cache
+    double linkStateCacheDistance_;
+
+    static unsigned int linkKey(MacNodeId txId, MacNodeId rxId)
+    {
+        return ((unsigned int)txId << 16) | rxId;
+    }
+
+    // correlation-distance cell of a position, on the x-y plane
+    uint64_t correlationCellKey(const inet::Coord& coord) const
+    {
+        uint32_t x = (uint32_t)(int32_t)floor(coord.x / correlationDistance_);
+        uint32_t y = (uint32_t)(int32_t)floor(coord.y / correlationDistance_);
+        return ((uint64_t)x << 32) | y;
+    }
+
     //percentage of error probability reduction for each h-arq retransmission
     double harqReduction_;
 
@@ -96,6 +119,9 @@ class LteRealisticChannelModel : public LteChannelModel
     //pointer to Binder module
     LteBinder* binder_;
 
+    //source of the random draws of the channel (shadowing, LOS, fading and decoding errors)
+    cRNG* rng_;
+
     //Cable loss
     double cableLoss_;
 
@@ -118,20 +144,12 @@ class LteRealisticChannelModel : public LteChannelModel
 
     bool tolerateMaxDistViolation_;
 
-    //Struct used to store information about jakes fading
-    struct JakesFadingData
-    {
-        std::vector<double> angleOfArrival;
-        std::vector<simtime_t> delaySpread;
-    };
-
-    // for each node and for each band we store information about jakes fading
-    std::map<MacNodeId, std::vector<JakesFadingData> > jakesFadingMap_;
-
-    typedef std::vector<JakesFadingData> JakesFadingVector;
-    typedef std::map<MacNodeId, JakesFadingVector> JakesFadingMap;
+    // for each node and for each band we store the jakes fading paths, either local or shared
+    JakesFadingEngine* jakesFadingEngine_;
 
-//    typedef std::map<MacNodeId,std::vector<JakesFadingData> > JakesFadingMap;
+    // Gamma variates of the nakagami fading, and scratch buffer for one link
+    NakagamiFadingSampler nakagamiSampler_;
+    std::vector<double> nakagamiVariates_;
 
     enum FadingType
     {
@@ -147,6 +165,14 @@ class LteRealisticChannelModel : public LteChannelModel
     //if dynamicLos is false this boolean is initialized to true if all user will be in LOS or false otherwise
     bool fixedLos_;
 
+    // scratch buffers reused by the per-band D2D computations
+    std::vector<double> inCellInterference_;
+    std::vector<double> snrBuffer_;
+    std::vector<double> linearBuffer_;
+    std::vector<double> denominatorBuffer_;
+    // transmitters around the receiver, filled by the in-cell D2D interference computation
+    std::vector<const ActiveTransmitter*> interferers_;
+
     inet::physicallayer::NakagamiFading* nkgmf;
 
   public:
@@ -171,6 +197,16 @@ class LteRealisticChannelModel : public LteChannelModel
      * @param coord position of end point comunication (if dir==UL is the position of UE else is the position of eNodeB)
      */
     virtual std::tuple<double, double> getAttenuation_D2D(MacNodeId nodeId, Direction dir, inet::Coord coord,MacNodeId node2_Id, inet::Coord coord_2);
+    /*
+     * Same as getAttenuation_D2D, but path loss, LOS and shadowing are kept per (tx, rx) link
+     * and only refreshed when the pair has moved (see LinkState)
+     */
+    virtual std::tuple<double, double> getCachedAttenuation_D2D(MacNodeId nodeId, Direction dir, inet::Coord coord,MacNodeId node2_Id, inet::Coord coord_2);
+    /*
+     * Same as getAttenuation_D2D, with LOS and shadowing drawn from the stream of the link in the
+     * shared state (see ChannelStateManager), so that nothing is stored per link
+     */
+    virtual std::tuple<double, double> getSharedAttenuation_D2D(MacNodeId nodeId, Direction dir, inet::Coord coord,MacNodeId node2_Id, inet::Coord coord_2);
     /*
      * Compute sir for each band for user nodeId according to multipath fading
      *
@@ -188,7 +224,7 @@ class LteRealisticChannelModel : public LteChannelModel
     /*
      * Compute Received useful signal for D2D transmissions
      */
-    virtual std::tuple<std::vector<double>, double> getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord);
+    virtual void getRSRP_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord, BandMeasurements& measurements);
     /*
      * Compute sinr (D2D) for each band for user nodeId according to pathloss, shadowing (optional) and multipath fading
      *
@@ -196,7 +232,7 @@ class LteRealisticChannelModel : public LteChannelModel
      * @param lteinfo pointer to the user control info
      */
     virtual std::vector<double> getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId);
-    virtual std::vector<double> getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector, bool interference);
+    virtual std::vector<double> getSINR_D2D(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,const std::vector<double>& rsrpVector, bool interference);
 
     /**
      *
@@ -205,10 +241,9 @@ class LteRealisticChannelModel : public LteChannelModel
      * @param destId id of destination
      * @param destCoord coordinates of destination
      * @param enbId associated enb ID (Not used)
-     * @param rsrpVector previously recorded RSRP vector
-     * @return
+     * @param measurements previously recorded RSRP vector, where the RSSI and SINR vectors are stored
      */
-    virtual std::tuple<std::vector<double>, std::vector<double>> getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId,std::vector<double> rsrpVector);
+    virtual void getRSSI_SINR(LteAirFrame *frame, UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord,MacNodeId enbId, BandMeasurements& measurements);
 
     /*
      * Compute the error probability of the transmitted packet according to cqi used, txmode, and the received power
@@ -218,7 +253,7 @@ class LteRealisticChannelModel : public LteChannelModel
      * @param lteinfo pointer to the user control info
      * @param rsrpVector the received signal for each RB, if it has already been computed
      */
-    virtual bool error_D2D(LteAirFrame *frame, UserControlInfo* lteI, std::vector<double> rsrpVector);
+    virtual bool error_D2D(LteAirFrame *frame, UserControlInfo* lteI, const std::vector<double>& rsrpVector);
     /*
      * Compute the error probability of the transmitted packet according to mcs used, txmode, and the received power
      * after that it throws a random number in order to check if this packet will be corrupted or not
@@ -229,7 +264,7 @@ class LteRealisticChannelModel : public LteChannelModel
      * @param mcs the modulation and coding scheme used in sending the message.
      * @returns a tuple specifying whether it was successfully received based on SNR and SINR
      */
-    virtual std::tuple<bool, bool> error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, std::vector<double> rsrpVector, std::vector<double> sinrVector, int mcs);
+    virtual std::tuple<bool, bool> error_Mode4(LteAirFrame *frame, UserControlInfo* lteInfo, const BandMeasurements& measurements, int mcs);
     /*
      * Compute the error probability of the transmitted packet according to cqi used, txmode, and the received power
      * after that it throws a random number in order to check if this packet will be corrupted or not
@@ -318,14 +353,31 @@ class LteRealisticChannelModel : public LteChannelModel
      */
     void computeLosProbability(double d, MacNodeId nodeId);
 
-    JakesFadingMap * getJakesMap()
+    JakesFadingEngine * getJakesEngine()
     {
-        return &jakesFadingMap_;
+        return jakesFadingEngine_;
     }
 
+    /*
+     * Draws all the random numbers of this channel model (Nakagami fading included) from the
+     * given stream instead of the simulation RNGs, e.g. to evaluate it on a worker thread
+     */
+    void setRng(cRNG* rng)
+    {
+        rng_ = rng;
+        nakagamiSampler_.setRng(rng);
+    }
+
+    /*
+     * Creates the jakes paths of a D2D transmitter, if needed, and computes their fading for the
+     * current TTI in the engine read by all its receivers (see getRSRP_D2D). Called serially before
+     * the receptions of a TTI are evaluated on several threads, which then only read the engine
+     */
+    void prepareJakesFading_D2D(MacNodeId sourceId, const inet::Coord& sourceCoord);
+
   protected:
 
-    /* compute speed (m/s) for a given node
+    /* compute speed (m/s) for a given node, once per TTI for all the receivers
      * @param nodeid mac node id of UE
      * @return the speed in m/s
      */
@@ -337,6 +389,12 @@ class LteRealisticChannelModel : public LteChannelModel
      */
     void updatePositionHistory(const MacNodeId nodeId, const inet::Coord coord);
 
+    /*
+     * Path loss (dB) of a D2D link for the configured scenario, with the LOS state
+     * read from losMap_[nodeId]; dbp is set to the breakpoint distance, if any
+     */
+    double computeD2DPathLoss(double distance, double& dbp, MacNodeId nodeId, const inet::Coord& coord);
+
     /*
      * compute total interference due to eNB coexistence
      * @param eNbId id of the considered eNb
@@ -345,6 +403,32 @@ class LteRealisticChannelModel : public LteChannelModel
     bool computeMultiCellInterference(MacNodeId eNbId, MacNodeId ueId, inet::Coord coord, bool isCqi,
         std::vector<double> * interference);
 
+    /*
+     * Computes the SINR (or SNR if interference is false) of each band from a previously
+     * computed RSRP vector, writing it to snrVector
+     */
+    void computeSINR_D2D(UserControlInfo* lteInfo_1, MacNodeId destId, inet::Coord destCoord, MacNodeId enbId,
+        const std::vector<double>& rsrpVector, bool interference, std::vector<double>& snrVector);
+
+    /*
+     * Computes the SINR of each band of a unicast D2D transmission, writing it to snrVector
+     * (see getSINR_D2D)
+     */
+    void computeUnicastSINR_D2D(UserControlInfo* lteInfo, MacNodeId destId, inet::Coord destCoord, MacNodeId enbId,
+        std::vector<double>& snrVector);
+
+    /*
+     * BLER of a sidelink transmission (PSCCH if sci, PSSCH with the given MCS otherwise)
+     * for the given average SINR (dB)
+     */
+    double getSidelinkBler(bool sci, int mcs, double sinr);
+
+    /*
+     * Mean over shapeFactor_ of the Nakagami fading (dB) of a D2D link of the given length,
+     * i.e. the factor the Gamma(shapeFactor_, 1) variates are scaled by
+     */
+    double getNakagamiScale(double distance);
+
     /*
      * compute total interference due to D2D transmissions within the same cell
      */
@@ -364,10 +448,10 @@ class LteRealisticChannelModel : public LteChannelModel
     double computeExtCellPathLoss(double dist, MacNodeId nodeId);
 
     /*
-     * Obtain the jakes map for the specified UE
+     * Obtain the jakes fading engine for the specified UE
      * @param id mac id of the user
      */
-    JakesFadingMap * obtainUeJakesMap(MacNodeId id);
+    JakesFadingEngine * obtainUeJakesEngine(MacNodeId id);
 };
 
 #endif
@@ -0,0 +1,156 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "stack/phy/ChannelModel/NakagamiFadingSampler.h"
+#include "common/CounterRng.h"
+
+/*
+ * Fills out with n Gamma(shape, 1) variates, drawing from rng in one pass.
+ * Same methods as gamma_d (exponential for shape 1, Marsaglia-Tsang otherwise, boosted
+ * by U^(1/shape) below 1), but the constants are computed once per batch and both
+ * normals of each Box-Muller pair are used, instead of one per call.
+ */
+static void fillGamma(cRNG* rng, double shape, double* out, unsigned int n)
+{
+    if (shape == 1.0)
+    {
+        for (unsigned int i = 0; i < n; i++)
+            out[i] = 1.0 - rng->doubleRand();
+        for (unsigned int i = 0; i < n; i++)
+            out[i] = -log(out[i]);
+        return;
+    }
+
+    double a = (shape < 1.0) ? shape + 1.0 : shape;
+    double d = a - 1.0 / 3.0;
+    double c = 1.0 / sqrt(9.0 * d);
+    double spare = 0.0;
+    bool hasSpare = false;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (;;)
+        {
+            double x, v;
+            do
+            {
+                if (hasSpare)
+                {
+                    x = spare;
+                    hasSpare = false;
+                }
+                else
+                {
+                    double r = sqrt(-2.0 * log(1.0 - rng->doubleRand()));
+                    double theta = 2.0 * M_PI * rng->doubleRand();
+                    x = r * cos(theta);
+                    spare = r * sin(theta);
+                    hasSpare = true;
+                }
+                v = 1.0 + c * x;
+            } while (v <= 0);
+            v = v * v * v;
+            double u = rng->doubleRand();
+            double x2 = x * x;
+            if (u < 1.0 - 0.0331 * x2 * x2 || log(u) < 0.5 * x2 + d * (1.0 - v + log(v)))
+            {
+                out[i] = d * v;
+                break;
+            }
+        }
+    }
+
+    if (shape < 1.0)
+    {
+        double inverseShape = 1.0 / shape;
+        for (unsigned int i = 0; i < n; i++)
+            out[i] *= pow(rng->doubleRandNonz(), inverseShape);
+    }
+}
+
+NakagamiFadingSampler::NakagamiFadingSampler()
+{
+    shape_ = 1.0;
+    rng_ = NULL;
+    coherenceTime_ = 0;
+    coherenceBands_ = 1;
+    next_ = 0;
+}
+
+void NakagamiFadingSampler::initialise(double shape, int rngIndex, simtime_t coherenceTime, unsigned int coherenceBands, unsigned int batchSize)
+{
+    if (rngIndex < 0 || rngIndex >= getEnvir()->getNumRNGs())
+        throw cRuntimeError("NakagamiFadingSampler::initialise - RNG %d does not exist, check num-rngs", rngIndex);
+    if (coherenceBands == 0)
+        throw cRuntimeError("NakagamiFadingSampler::initialise - the coherence bandwidth must span at least one band");
+
+    shape_ = shape;
+    rng_ = getEnvir()->getRNG(rngIndex);
+    coherenceTime_ = coherenceTime;
+    coherenceBands_ = coherenceBands;
+    batch_.resize(batchSize > 0 ? batchSize : 1);
+    next_ = batch_.size();
+    links_.clear();
+}
+
+void NakagamiFadingSampler::refill()
+{
+    fillGamma(rng_, shape_, batch_.data(), batch_.size());
+    next_ = 0;
+}
+
+void NakagamiFadingSampler::sample(unsigned int linkKey, std::vector<double>& variates, unsigned int numBands)
+{
+    variates.resize(numBands);
+
+    LinkFading* link = NULL;
+    if (coherenceTime_ > 0)
+    {
+        link = &links_[linkKey];
+        if (link->variates.size() == numBands && NOW - link->drawTime < coherenceTime_)
+        {
+            // still coherent, keep the realization
+            variates = link->variates;
+            return;
+        }
+    }
+
+    double variate = 0;
+    for (unsigned int i = 0; i < numBands; i++)
+    {
+        if (i % coherenceBands_ == 0)
+            variate = draw();
+        variates[i] = variate;
+    }
+
+    if (link != NULL)
+    {
+        link->drawTime = NOW;
+        link->variates = variates;
+    }
+}
+
+void NakagamiFadingSampler::sampleShared(uint64_t seed, unsigned int linkKey, std::vector<double>& variates, unsigned int numBands)
+{
+    if (coherenceTime_ == 0)
+    {
+        // a fresh realization for every frame, nothing is kept for the link anyway
+        sample(linkKey, variates, numBands);
+        return;
+    }
+
+    uint64_t interval = (uint64_t)floor(NOW / coherenceTime_);
+    CounterRng linkRng(CounterRng::makeKey(CounterRng::makeKey(seed, linkKey), interval));
+
+    // one variate per group of coherent bands, spread from the last band down so that none is overwritten before use
+    variates.resize(numBands);
+    unsigned int numVariates = (numBands + coherenceBands_ - 1) / coherenceBands_;
+    fillGamma(&linkRng, shape_, variates.data(), numVariates);
+    for (unsigned int i = numBands; i-- > 0;)
+        variates[i] = variates[i / coherenceBands_];
+}
@@ -0,0 +1,92 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_NAKAGAMIFADINGSAMPLER_H_
+#define _LTE_NAKAGAMIFADINGSAMPLER_H_
+
+#include <stdint.h>
+#include <unordered_map>
+#include "common/LteCommon.h"
+
+/**
+ * Source of the Gamma(shape, 1) variates used by the Nakagami fading of
+ * D2D links.
+ *
+ * The variates are drawn in batches from a dedicated RNG, so that the fading
+ * does not depend on (nor perturb) the draws of other modules. A batch is
+ * filled in one pass over the generator rather than by one gamma_d() call
+ * per variate; with shape 1 (the default) the variates are the same. A link may
+ * also hold its realization for a coherence time, and adjacent bands may
+ * share one variate (coherence bandwidth): with the defaults (no coherence
+ * time, one band) every band of every frame gets a fresh variate, as
+ * before. Callers scale the variates to the mean they need, which leaves
+ * the marginal distribution unchanged.
+ */
+class NakagamiFadingSampler
+{
+  protected:
+    struct LinkFading
+    {
+        simtime_t drawTime;
+        std::vector<double> variates;
+    };
+
+    double shape_;
+    cRNG* rng_;
+    simtime_t coherenceTime_;
+    unsigned int coherenceBands_;
+
+    std::vector<double> batch_;
+    unsigned int next_;
+
+    // realizations held within the coherence time, by link
+    std::unordered_map<unsigned int, LinkFading> links_;
+
+    double draw()
+    {
+        if (next_ == batch_.size())
+            refill();
+        return batch_[next_++];
+    }
+    void refill();
+
+  public:
+    NakagamiFadingSampler();
+
+    /**
+     * @param rngIndex index of the physical RNG reserved to the fading
+     * @param coherenceTime time a link keeps its realization, 0 draws it for every frame
+     * @param coherenceBands number of adjacent bands sharing one variate
+     */
+    void initialise(double shape, int rngIndex, simtime_t coherenceTime, unsigned int coherenceBands, unsigned int batchSize);
+
+    /**
+     * Draws the next batches from the given stream, dropping the variates already drawn
+     */
+    void setRng(cRNG* rng)
+    {
+        rng_ = rng;
+        next_ = batch_.size();
+    }
+
+    /**
+     * Fills variates with one Gamma(shape, 1) value per band for the given link,
+     * reusing the link's realization if it is still coherent.
+     */
+    void sample(unsigned int linkKey, std::vector<double>& variates, unsigned int numBands);
+
+    /**
+     * Same as sample(), without storing anything for the link: within a coherence
+     * time the realization is drawn from a stream keyed by the seed, the link and the
+     * coherence interval (aligned to multiples of the coherence time) it falls in.
+     */
+    void sampleShared(uint64_t seed, unsigned int linkKey, std::vector<double>& variates, unsigned int numBands);
+};
+
+#endif
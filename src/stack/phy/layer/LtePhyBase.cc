@@ -15,6 +15,7 @@ short LtePhyBase::airFramePriority_ = 10;
 LtePhyBase::LtePhyBase()
 {
     channelModel_ = NULL;
+    binder_ = NULL;
 }
 
 LtePhyBase::~LtePhyBase()
@@ -52,6 +53,11 @@ void LtePhyBase::initialize(int stage)
     }
 }
 
+void LtePhyBase::registerActiveTransmission(const RbMap& rbMap, Direction dir)
+{
+    binder_->registerActiveTransmitter(this, nodeId_, getRadioPosition(), getTxPwr(dir), rbMap);
+}
+
 void LtePhyBase::handleMessage(cMessage* msg)
 {
     EV << " LtePhyBase::handleMessage - new message received" << endl;
@@ -192,6 +198,8 @@ LteChannelModel* LtePhyBase::getChannelModelFromName(std::string name, Parameter
         return initializeDummyChannelModel(params);
     else if (name == "REAL")
         return initializeChannelModel(params);
+    else if (name == "ABSTRACT")
+        return initializeAbstractChannelModel(params);
     else
         return 0;
 }
@@ -201,6 +209,11 @@ LteChannelModel* LtePhyBase::initializeChannelModel(ParameterMap& params)
     return new LteRealisticChannelModel(params, getRadioPosition(), binder_->getNumBands());
 }
 
+LteChannelModel* LtePhyBase::initializeAbstractChannelModel(ParameterMap& params)
+{
+    return new LteAbstractChannelModel(params, getRadioPosition(), binder_->getNumBands());
+}
+
 LteChannelModel* LtePhyBase::initializeDummyChannelModel(ParameterMap& params)
 {
     return new LteDummyChannelModel(params, binder_->getNumBands());
@@ -25,6 +25,7 @@
 #include "stack/phy/ChannelModel/LteChannelModel.h"
 #include "stack/phy/feedback/LteFeedbackComputationRealistic.h"
 #include "stack/phy/ChannelModel/LteRealisticChannelModel.h"
+#include "stack/phy/ChannelModel/LteAbstractChannelModel.h"
 #include "stack/phy/ChannelModel/LteDummyChannelModel.h"
 
 /**
@@ -300,6 +301,14 @@ class LtePhyBase : public ChannelAccess
      *               xml file, used to initialize this object.
      */
     LteChannelModel* initializeChannelModel(ParameterMap& params);
+    /**
+     * Creates and initializes a LteAbstractChannelModel with the
+     * passed parameter values.
+     *
+     * @param params map that contains the parameters read from the
+     *               xml file, used to initialize this object.
+     */
+    LteChannelModel* initializeAbstractChannelModel(ParameterMap& params);
     /**
      * Creates and initializes a LteDummyChannelModel with the
      * passed parameter values.
@@ -309,6 +318,15 @@ class LtePhyBase : public ChannelAccess
      */
     LteChannelModel* initializeDummyChannelModel(ParameterMap& params);
 
+    /**
+     * Records the transmission performed in the current TTI in the binder,
+     * so that interference computation only visits the actual transmitters.
+     *
+     * @param rbMap RBs used for the transmission
+     * @param dir direction of the transmission
+     */
+    void registerActiveTransmission(const RbMap& rbMap, Direction dir);
+
     /**
      * Utility.
      * Shows current statistics above the icon.
@@ -144,7 +144,7 @@ bool LtePhyEnb::handleControlPkt(UserControlInfo* lteinfo, LteAirFrame* frame)
 
 void LtePhyEnb::handleAirFrame(cMessage* msg)
 {
-    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(msg->removeControlInfo());
+    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(check_and_cast<LteAirFrame*>(msg)->removePrivateControlInfo());
     if (!lteInfo)
     {
         return;
@@ -139,7 +139,7 @@ void LtePhyEnbD2D::requestFeedback(UserControlInfo* lteinfo, LteAirFrame* frame,
 
 void LtePhyEnbD2D::handleAirFrame(cMessage* msg)
 {
-    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(msg->removeControlInfo());
+    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(check_and_cast<LteAirFrame*>(msg)->removePrivateControlInfo());
     LteAirFrame* frame = static_cast<LteAirFrame*>(msg);
 
     EV << "LtePhyEnbD2D::handleAirFrame - received new LteAirFrame with ID " << frame->getId() << " from channel" << endl;
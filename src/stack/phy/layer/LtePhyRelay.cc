@@ -60,7 +60,7 @@ void LtePhyRelay::handleSelfMessage(cMessage *msg)
 
 void LtePhyRelay::handleAirFrame(cMessage* msg)
 {
-    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(msg->removeControlInfo());
+    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(check_and_cast<LteAirFrame*>(msg)->removePrivateControlInfo());
     LteAirFrame* frame = static_cast<LteAirFrame*>(msg);
     EV << "LtePhy: received new LteAirFrame with ID "
        << frame->getId() << " from channel" << endl;
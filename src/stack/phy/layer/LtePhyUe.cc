@@ -345,7 +345,7 @@ void LtePhyUe::doHandover()
 // TODO: ***reorganize*** method
 void LtePhyUe::handleAirFrame(cMessage* msg)
 {
-    UserControlInfo* lteInfo = dynamic_cast<UserControlInfo*>(msg->removeControlInfo());
+    UserControlInfo* lteInfo = dynamic_cast<UserControlInfo*>(check_and_cast<LteAirFrame*>(msg)->removePrivateControlInfo());
 
     if (useBattery_)
     {
@@ -503,6 +503,7 @@ void LtePhyUe::handleUpperMessage(cMessage* msg)
             ++it;
     }
     lastActive_ = NOW;
+    registerActiveTransmission(rbMap, lteInfo->getDirection());
 
     if (lteInfo->getFrameType() == DATAPKT && lteInfo->getUserTxParams() != NULL)
     {
@@ -18,10 +18,12 @@ LtePhyUeD2D::LtePhyUeD2D()
 {
     handoverStarter_ = NULL;
     handoverTrigger_ = NULL;
+    bestMeasurements_ = NULL;
 }
 
 LtePhyUeD2D::~LtePhyUeD2D()
 {
+    delete bestMeasurements_;
 }
 
 void LtePhyUeD2D::initialize(int stage)
@@ -47,6 +49,13 @@ void LtePhyUeD2D::handleSelfMessage(cMessage *msg)
         // decode the selected frame
         decodeAirFrame(frame, lteInfo);
 
+        // give the measurements of the decoded frame back to the pool
+        if (bestMeasurements_ != NULL)
+        {
+            measurementPool_.release(bestMeasurements_);
+            bestMeasurements_ = NULL;
+        }
+
         // clear buffer
         while (!d2dReceivedFrames_.empty())
         {
@@ -65,7 +74,7 @@ void LtePhyUeD2D::handleSelfMessage(cMessage *msg)
 // TODO: ***reorganize*** method
 void LtePhyUeD2D::handleAirFrame(cMessage* msg)
 {
-    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(msg->removeControlInfo());
+    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(check_and_cast<LteAirFrame*>(msg)->removePrivateControlInfo());
 
     if (useBattery_)
     {
@@ -256,6 +265,7 @@ void LtePhyUeD2D::handleUpperMessage(cMessage* msg)
             ++it;
     }
     lastActive_ = NOW;
+    registerActiveTransmission(rbMap, lteInfo->getDirection());
 
     if (lteInfo->getFrameType() == DATAPKT && lteInfo->getUserTxParams() != NULL)
     {
@@ -311,7 +321,7 @@ void LtePhyUeD2D::storeAirFrame(LteAirFrame* newFrame)
     Coord myCoord = getCoord();
     double distance = 0.0;
     double rsrpMean = 0.0;
-    std::vector<double> rsrpVector;
+    BandMeasurements* measurements = NULL;
     bool useRsrp = false;
 
     if (strcmp(par("d2dMulticastCaptureEffectFactor"),"RSRP") == 0)
@@ -321,13 +331,14 @@ void LtePhyUeD2D::storeAirFrame(LteAirFrame* newFrame)
         double sum = 0.0;
         unsigned int allocatedRbs = 0;
 
-        std::tuple<std::vector<double>, double> rsrpAttenuation = channelModel_->getRSRP_D2D(newFrame, newInfo, nodeId_, myCoord);
-        rsrpVector = get<0>(rsrpAttenuation);
+        measurements = measurementPool_.acquire(binder_->getNumBands());
+        channelModel_->getRSRP_D2D(newFrame, newInfo, nodeId_, myCoord, *measurements);
+        const std::vector<double>& rsrpVector = measurements->rsrpVector;
 
         // get the average RSRP on the RBs allocated for the transmission
-        RbMap rbmap = newInfo->getGrantedBlocks();
-        RbMap::iterator it;
-        std::map<Band, unsigned int>::iterator jt;
+        const RbMap& rbmap = newInfo->getGrantedBlocks();
+        RbMap::const_iterator it;
+        std::map<Band, unsigned int>::const_iterator jt;
         //for each Remote unit used to transmit the packet
         for (it = rbmap.begin(); it != rbmap.end(); ++it)
         {
@@ -375,12 +386,15 @@ void LtePhyUeD2D::storeAirFrame(LteAirFrame* newFrame)
             delete prevFrame;
 
             bestRsrpMean_ = rsrpMean;
-            bestRsrpVector_ = rsrpVector;
+            measurementPool_.release(bestMeasurements_);
+            bestMeasurements_ = measurements;
             d2dReceivedFrames_.push_back(newFrame);
         }
         else
         {
             // this frame will not be decoded
+            if (measurements != NULL)
+                measurementPool_.release(measurements);
             delete newFrame;
         }
     }
@@ -394,7 +408,7 @@ void LtePhyUeD2D::storeAirFrame(LteAirFrame* newFrame)
         else
         {
             bestRsrpMean_ = rsrpMean;
-            bestRsrpVector_ = rsrpVector;
+            bestMeasurements_ = measurements;
             d2dReceivedFrames_.push_back(newFrame);
         }
     }
@@ -415,11 +429,11 @@ void LtePhyUeD2D::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo)
     // apply decider to received packet
     bool result = true;
 
-    RemoteSet r = lteInfo->getUserTxParams()->readAntennaSet();
+    const RemoteSet& r = lteInfo->getUserTxParams()->readAntennaSet();
     if (r.size() > 1)
     {
         // DAS
-        for (RemoteSet::iterator it = r.begin(); it != r.end(); it++)
+        for (RemoteSet::const_iterator it = r.begin(); it != r.end(); it++)
         {
             EV << "LtePhyUeD2D::decodeAirFrame: Receiving Packet from antenna " << (*it) << "\n";
 
@@ -444,7 +458,15 @@ void LtePhyUeD2D::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo)
     {
         //RELAY and NORMAL
         if (lteInfo->getDirection() == D2D_MULTI)
-            result = channelModel_->error_D2D(frame,lteInfo,bestRsrpVector_);
+        {
+            // when capturing by distance the RSRP of the selected frame has not been measured yet
+            if (bestMeasurements_ == NULL)
+            {
+                bestMeasurements_ = measurementPool_.acquire(binder_->getNumBands());
+                channelModel_->getRSRP_D2D(frame, lteInfo, nodeId_, getCoord(), *bestMeasurements_);
+            }
+            result = channelModel_->error_D2D(frame,lteInfo,bestMeasurements_->rsrpVector);
+        }
         else
             result = channelModel_->error(frame,lteInfo);
     }
@@ -24,7 +24,7 @@ class LtePhyUeD2D : public LtePhyUe
      */
     bool d2dMulticastEnableCaptureEffect_;
     double nearestDistance_;
-    std::vector<double> bestRsrpVector_;
+    BandMeasurements* bestMeasurements_;          // RSRP of the frame to be decoded, NULL when capturing by distance
     double bestRsrpMean_;
     std::vector<LteAirFrame*> d2dReceivedFrames_; // airframes received in the current TTI. Only one will be decoded
     cMessage* d2dDecodingTimer_;                  // timer for triggering decoding at the end of the TTI. Started
@@ -32,6 +32,9 @@ class LtePhyUeD2D : public LtePhyUe
     void storeAirFrame(LteAirFrame* newFrame);
     LteAirFrame* extractAirFrame();
     void decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo);
+
+    // Per-band measurement records not currently in use, reused across TTIs
+    BandMeasurementsPool measurementPool_;
     // ---------------------------------------------------------------- //
 
     virtual void initialize(int stage);
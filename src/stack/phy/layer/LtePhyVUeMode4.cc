@@ -16,7 +16,11 @@
 #include <algorithm>
 #include <iterator>
 #include <vector>
+#include <unordered_set>
 #include "stack/phy/layer/LtePhyVUeMode4.h"
+#include "stack/phy/layer/Mode4Reservations.h"
+#include "stack/phy/ChannelModel/LteRealisticChannelModel.h"
+#include "corenetwork/reception/Mode4ReceptionStage.h"
 #include "stack/phy/packet/LteFeedbackPkt.h"
 #include "stack/d2dModeSelection/D2DModeSelectionBase.h"
 #include "stack/phy/packet/SpsCandidateResources.h"
@@ -28,10 +32,22 @@ LtePhyVUeMode4::LtePhyVUeMode4()
 {
     handoverStarter_ = NULL;
     handoverTrigger_ = NULL;
+    receptionStage_ = NULL;
+    receptionPending_ = false;
+    receptionRng_ = NULL;
+    cbrTimer_ = NULL;
+    positionTimer_ = NULL;
 }
 
 LtePhyVUeMode4::~LtePhyVUeMode4()
 {
+    for (int i = 0; i < sciInfo_.size(); i++)
+        delete sciInfo_[i].measurements;
+    for (int i = 0; i < tbInfo_.size(); i++)
+        delete tbInfo_[i].measurements;
+    delete receptionRng_;
+    cancelAndDelete(cbrTimer_);
+    cancelAndDelete(positionTimer_);
 }
 
 void LtePhyVUeMode4::initialize(int stage)
@@ -48,7 +64,13 @@ void LtePhyVUeMode4::initialize(int stage)
         selectionWindowStartingSubframe_ = par("selectionWindowStartingSubframe");
         numSubchannels_                  = par("numSubchannels");
         subchannelSize_                  = par("subchannelSize");
+        if (numSubchannels_ < 1 || numSubchannels_ > 64)
+            throw cRuntimeError("LtePhyVUeMode4::initialize - numSubchannels must be between 1 and 64, got %d", numSubchannels_);
+
+        // Subframe offsets of the q-th repetition of a reservation, for each RRI code
+        computeRriOffsets(pStep_, rriOffsets_);
         d2dDecodingTimer_                = NULL;
+        decodedTbs_                      = 0;
         transmitting_                    = false;
         beginTransmission_               = false;
         rssiFiltering_                   = par("rssiFiltering");
@@ -56,6 +78,10 @@ void LtePhyVUeMode4::initialize(int stage)
 
         checkAwareness_                  = par("checkAwareness");
 
+        positionRecordingInterval_       = par("positionRecordingInterval");
+        if (positionRecordingInterval_ < 0)
+            throw cRuntimeError("LtePhyVUeMode4::initialize - positionRecordingInterval must not be negative");
+
         int thresholdRSSI                = par("thresholdRSSI");
 
         thresholdRSSI_ = (-112 + 2 * thresholdRSSI);
@@ -169,6 +195,17 @@ void LtePhyVUeMode4::initialize(int stage)
         nodeId_ = getAncestorPar("macNodeId");
 
         initialiseSensingWindow();
+
+        // with a reception stage, the channel model may run on a worker thread and needs its own random stream
+        receptionStage_ = getMode4ReceptionStage();
+        if (receptionStage_ != NULL)
+        {
+            LteRealisticChannelModel* realisticModel = dynamic_cast<LteRealisticChannelModel*>(channelModel_);
+            if (realisticModel == NULL)
+                throw cRuntimeError("LtePhyVUeMode4::initialize - the reception stage requires the realistic channel model");
+            receptionRng_ = new CounterRng(CounterRng::makeKey(receptionStage_->getSeed(), nodeId_));
+            realisticModel->setRng(receptionRng_);
+        }
     }
 }
 
@@ -176,52 +213,39 @@ void LtePhyVUeMode4::handleSelfMessage(cMessage *msg)
 {
     if (msg->isName("d2dDecodingTimer"))
     {
-        std::sort(begin(sciInfo_), end(sciInfo_), [](const std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double> &t1,
-        const std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double> &t2) {
-            return get<5>(t1) < get<5>(t2); // or use a custom compare function
-        });
-
-        std::sort(begin(tbInfo_), end(tbInfo_), [](const std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double> &t1,
-        const std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double> &t2) {
-            return get<5>(t1) < get<5>(t2); // or use a custom compare function
-        });
+        advanceSensingWindow();
+
+        // Frames are decoded from the back, i.e. starting from the highest average SINR
+        auto lowerSinr = [](const ReceivedFrame& f1, const ReceivedFrame& f2) {
+            return f1.averageSinr < f2.averageSinr;
+        };
+        std::sort(sciInfo_.begin(), sciInfo_.end(), lowerSinr);
+        std::sort(tbInfo_.begin(), tbInfo_.end(), lowerSinr);
+
+        std::unordered_set<MacNodeId> tbSources;
+        for (int j=0; j<tbInfo_.size(); j++){
+            tbSources.insert(tbInfo_[j].info->getSourceId());
+        }
 
-        std::vector<int> missingTbs;
+        // missingTbs[n] is set when the n-th SCI to be decoded has no corresponding TB
+        std::vector<bool> missingTbs(sciInfo_.size(), false);
+        int numMissingTbs = 0;
         for (int i=0; i<sciInfo_.size(); i++){
-            bool foundTB=false;
-            LteAirFrame* sciFrame = get<0>(sciInfo_[i]);
-            UserControlInfo* sciInfo = check_and_cast<UserControlInfo*>(sciFrame->removeControlInfo());
-            for (int j=0; j<tbInfo_.size();j++){
-                LteAirFrame* tbFrame = get<0>(tbInfo_[j]);
-                UserControlInfo* tbInfo = check_and_cast<UserControlInfo*>(tbFrame->removeControlInfo());
-                if (sciInfo->getSourceId() == tbInfo->getSourceId()){
-                    foundTB = true;
-                    tbFrame->setControlInfo(tbInfo);
-                    break;
-                }
-                tbFrame->setControlInfo(tbInfo);
+            if (tbSources.find(sciInfo_[i].info->getSourceId()) == tbSources.end()){
+                missingTbs[sciInfo_.size() - 1 - i] = true;
+                numMissingTbs++;
             }
-            if (!foundTB){
-                missingTbs.push_back(sciInfo_.size() - 1 - i);
-            }
-            sciFrame->setControlInfo(sciInfo);
         }
 
         while (!sciInfo_.empty()){
-            std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double> sciTuple = sciInfo_.back();
             // Get received SCI and it's corresponding RsrpVector
-            LteAirFrame* frame = get<0>(sciTuple);
-            std::vector<double> rsrpVector = get<1>(sciTuple);
-            std::vector<double> rssiVector = get<2>(sciTuple);
-            std::vector<double> sinrVector = get<3>(sciTuple);
-            double attenuation = get<4>(sciTuple);
-
-            sciInfo_.pop_back();
-
-            UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(frame->removeControlInfo());
+            ReceivedFrame& sci = sciInfo_.back();
 
             // decode the selected frame
-            decodeAirFrame(frame, lteInfo, rsrpVector, rssiVector, sinrVector, attenuation);
+            decodeAirFrame(sci.frame, sci.info, *sci.measurements);
+            measurementPool_.release(sci.measurements);
+
+            sciInfo_.pop_back();
 
             emit(sciReceived, sciReceived_);
             emit(sciUnsensed, sciUnsensed_);
@@ -244,37 +268,20 @@ void LtePhyVUeMode4::handleSelfMessage(cMessage *msg)
         }
         int countTbs = 0;
         while (!tbInfo_.empty()){
-            auto missingPosition = std::find(missingTbs.begin(), missingTbs.end(), countTbs);
-            if(missingPosition != missingTbs.end()) {
-                missingTbs.erase(missingPosition);
+            if (countTbs < missingTbs.size() && missingTbs[countTbs]) {
                 // This corresponds to where we are missing a TB, record results as being negative to identify this.
-                emit(txRxDistanceTB, -1);
-                emit(tbReceived, -1);
-                emit(tbDecoded, -1);
-                emit(tbFailedDueToNoSCI, -1);
-                emit(tbFailedDueToProp, -1);
-                emit(tbFailedDueToInterference, -1);
-                emit(tbFailedButSCIReceived, -1);
-                emit(tbFailedHalfDuplex, -1);
-                emit(periodic, -1);
-
-                emit(tbFailedDueToPropIgnoreSCI ,-1);
-                emit(tbFailedDueToInterferenceIgnoreSCI ,-1);
-                emit(tbDecodedIgnoreSCI ,-1);
+                numMissingTbs--;
+                recordMissingTb();
             } else {
-                std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double> tbTuple = tbInfo_.back();
-                LteAirFrame* frame = get<0>(tbTuple);
-                std::vector<double> rsrpVector = get<1>(tbTuple);
-                std::vector<double> rssiVector = get<2>(tbTuple);
-                std::vector<double> sinrVector = get<3>(tbTuple);
-                double attenuation = get<4>(tbTuple);
-
-                tbInfo_.pop_back();
-
-                UserControlInfo *lteInfo = check_and_cast<UserControlInfo *>(frame->removeControlInfo());
+                ReceivedFrame& tb = tbInfo_.back();
+                UserControlInfo *lteInfo = tb.info;
 
                 // decode the selected frame
-                decodeAirFrame(frame, lteInfo, rsrpVector, rssiVector, sinrVector, attenuation);
+                decodeAirFrame(tb.frame, lteInfo, *tb.measurements);
+                measurementPool_.release(tb.measurements);
+                decodedTbs_++;
+
+                tbInfo_.pop_back();
 
                 emit(tbReceived, tbReceived_);
                 emit(tbDecoded, tbDecoded_);
@@ -303,27 +310,18 @@ void LtePhyVUeMode4::handleSelfMessage(cMessage *msg)
             }
             countTbs++;
         }
-        if (!missingTbs.empty()){
-            for(int i=0; i<missingTbs.size(); i++){
-                emit(txRxDistanceTB, -1);
-                emit(tbReceived, -1);
-                emit(tbDecoded, -1);
-                emit(tbFailedDueToNoSCI, -1);
-                emit(tbFailedDueToProp, -1);
-                emit(tbFailedDueToInterference, -1);
-                emit(tbFailedButSCIReceived, -1);
-                emit(tbFailedHalfDuplex, -1);
-                emit(periodic, -1);
-
-                emit(tbFailedDueToPropIgnoreSCI ,-1);
-                emit(tbFailedDueToInterferenceIgnoreSCI ,-1);
-                emit(tbDecodedIgnoreSCI ,-1);
-            }
+        for (int i=0; i<numMissingTbs; i++){
+            recordMissingTb();
         }
-        std::vector<cPacket*>::iterator it;
+        std::unordered_map<MacNodeId, std::vector<cPacket*>>::iterator it;
         for(it=scis_.begin();it!=scis_.end();it++)
         {
-            delete(*it);
+            std::vector<cPacket*>::iterator jt;
+            for(jt=it->second.begin();jt!=it->second.end();jt++)
+            {
+                // the control info is deleted along with the SCI
+                delete(*jt);
+            }
         }
         sciInfo_.clear();
         tbInfo_.clear();
@@ -331,27 +329,24 @@ void LtePhyVUeMode4::handleSelfMessage(cMessage *msg)
         delete msg;
         d2dDecodingTimer_ = NULL;
     }
-    else if (msg->isName("updateSubframe"))
+    else if (msg == cbrTimer_)
     {
-        transmitting_ = false;
-        if (beginTransmission_){
-            transmitting_ = true;
-            beginTransmission_ = false;
-        }
-        updateSubframe();
-        if (cbrCountDown_ == 0) {
-            // Ensures we update CBR every 100ms
-            updateCBR();
-            cbrCountDown_ = 99;
-            if (checkAwareness_) {
-                // Function allow to check IPG table to see if nodes have successfully decoded packets
-                // within a defined range in the last 1s/500ms/200ms
-                recordAwareness();
-            }
-        } else {
-            cbrCountDown_ --;
+        advanceSensingWindow();
+        // Ensures we update CBR every 100ms
+        updateCBR();
+        if (checkAwareness_) {
+            // Function allow to check IPG table to see if nodes have successfully decoded packets
+            // within a defined range in the last 1s/500ms/200ms
+            recordAwareness();
         }
-        delete msg;
+        scheduleAt(NOW + TTI * 100, cbrTimer_);
+    }
+    else if (msg == positionTimer_)
+    {
+        // Record the position of the vehicle every positionRecordingInterval
+        emit(posX, getCoord().x);
+        emit(posY, getCoord().y);
+        scheduleAt(NOW + positionRecordingInterval_, positionTimer_);
     }
     else
         LtePhyUe::handleSelfMessage(msg);
@@ -360,33 +355,39 @@ void LtePhyVUeMode4::handleSelfMessage(cMessage *msg)
 // TODO: ***reorganize*** method
 void LtePhyVUeMode4::handleAirFrame(cMessage* msg)
 {
-    UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(msg->removeControlInfo());
+    LteAirFrame* frame = check_and_cast<LteAirFrame*>(msg);
+
+    // the control info may be shared with the other receivers of the frame:
+    // only take a private copy of it when the frame has actually to be processed
+    const UserControlInfo* peekInfo = check_and_cast<const UserControlInfo*>(frame->peekControlInfo());
+    UserControlInfo* lteInfo;
 
     connectedNodeId_ = masterId_;
-    LteAirFrame* frame = check_and_cast<LteAirFrame*>(msg);
     EV << "LtePhyVUeMode4: received new LteAirFrame with ID " << frame->getId() << " from channel" << endl;
     //Update coordinates of this user
-    if (lteInfo->getFrameType() == HANDOVERPKT)
+    if (peekInfo->getFrameType() == HANDOVERPKT)
     {
         // check if handover is already in process
         if (handoverTrigger_ != NULL && handoverTrigger_->isScheduled())
         {
-            delete lteInfo;
             delete frame;
             return;
         }
 
+        lteInfo = check_and_cast<UserControlInfo*>(frame->removePrivateControlInfo());
         handoverHandler(frame, lteInfo);
         return;
     }
 
-    // HACK: if this is a multicast connection, change the destId of the airframe so that upper layers can handle it
-    // All packets in mode 4 are multicast
-    lteInfo->setDestId(nodeId_);
-
     // send H-ARQ feedback up
-    if (lteInfo->getFrameType() == HARQPKT || lteInfo->getFrameType() == GRANTPKT || lteInfo->getFrameType() == RACPKT || lteInfo->getFrameType() == D2DMODESWITCHPKT)
+    if (peekInfo->getFrameType() == HARQPKT || peekInfo->getFrameType() == GRANTPKT || peekInfo->getFrameType() == RACPKT || peekInfo->getFrameType() == D2DMODESWITCHPKT)
     {
+        lteInfo = check_and_cast<UserControlInfo*>(frame->removePrivateControlInfo());
+
+        // HACK: if this is a multicast connection, change the destId of the airframe so that upper layers can handle it
+        // All packets in mode 4 are multicast
+        lteInfo->setDestId(nodeId_);
+
         handleControlMsg(frame, lteInfo);
         return;
     }
@@ -403,20 +404,24 @@ void LtePhyVUeMode4::handleAirFrame(cMessage* msg)
 
     Coord myCoord = getCoord();
     // Only store frames which are within 1500m over this the interference caused is negligible.
-    if (myCoord.distance(lteInfo->getCoord()) < 1500) {
-        // store frame, together with related control info
-        frame->setControlInfo(lteInfo);
+    if (myCoord.distance(peekInfo->getCoord()) < 1500) {
+        lteInfo = check_and_cast<UserControlInfo*>(frame->removePrivateControlInfo());
+
+        // HACK: if this is a multicast connection, change the destId of the airframe so that upper layers can handle it
+        // All packets in mode 4 are multicast
+        lteInfo->setDestId(nodeId_);
 
-        // Capture the Airframe for decoding later
-        storeAirFrame(frame);
+        // Capture the Airframe for decoding later, together with related control info
+        storeAirFrame(frame, lteInfo);
     } else {
-        delete lteInfo;
         delete frame;
     }
 }
 
 void LtePhyVUeMode4::handleUpperMessage(cMessage* msg)
 {
+    // grants and CSRs work on the sensing window of the current subframe
+    advanceSensingWindow();
 
     UserControlInfo* lteInfo = check_and_cast<UserControlInfo*>(msg->removeControlInfo());
 
@@ -451,7 +456,7 @@ void LtePhyVUeMode4::handleUpperMessage(cMessage* msg)
             for (int i=0; i<numSubchannels_; i++)
             {
                 // Mark all the subchannels as not sensed
-                sensingWindow_[sensingWindowFront_][i]->setSensed(false);
+                sensingWindow_.setSensed(sensingWindowFront_, i, false);
             }
         }
         return;
@@ -566,6 +571,7 @@ RbMap LtePhyVUeMode4::sendSciMessage(cMessage* msg, UserControlInfo* lteInfo)
             ++it;
     }
     lastActive_ = NOW;
+    registerActiveTransmission(allRbs, lteInfo->getDirection());
 
     SCIInfo->setFrameType(SCIPKT);
     SCIInfo->setGrantedBlocks(sciRbs);
@@ -685,6 +691,10 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
     int cResel = grant->getResourceReselectionCounter();
     int maxLatency = grant->getMaximumLatency();
     std::vector<double> allowedRRIs = grant->getPossibleRRIs();
+    std::vector<int> allowedRRICodes;
+    for (int i = 0; i < allowedRRIs.size(); i++) {
+        allowedRRICodes.push_back(getRRICode(allowedRRIs[i]));
+    }
 
     int sensingWindowLength = pStep_ * 10;
     if (sensingWindowSizeOverride_ > 0){
@@ -697,23 +707,22 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
 
     int totalPossibleCSRs = ((maxSelectionIndex - minSelectionIndex) * numSubchannels_) / grantLength;
 
-    // Create a set of all the possible CSRs
-    // Each SubchannelIndex being the starting index of a CSR.
-    // Subframe -> {SubchannelIndex, SubchannelIndex}
-    std::unordered_map<int, std::set<int>> possibleCSRs;
-    for (int i = minSelectionIndex; i <= maxSelectionIndex; i++) {
-        std::set<int> subframe;
-        for (int j = 0; j <= (numSubchannels_ - grantLength); j += grantLength) {
-            subframe.insert(j);
-        }
-        possibleCSRs[i] = subframe;
-    }
+    // Create a bitmap of all the possible CSRs
+    // Each subframe of the selection window has one bit per CSR, bit b being the CSR starting at subchannel b * grantLength.
+    int numSelectionSubframes = maxSelectionIndex - minSelectionIndex + 1;
+    int csrsPerSubframe = numSubchannels_ / grantLength;
+    uint64_t allCSRs = (csrsPerSubframe == 64) ? ~(uint64_t)0 : ((uint64_t)1 << csrsPerSubframe) - 1;
 
-    // subframes disallowed
-    std::vector<int> notSensedSubframes;
+    CsrBitmap csrs;
+    csrs.firstSubframe = minSelectionIndex;
+    csrs.grantLength = grantLength;
+    csrs.possible.assign(numSelectionSubframes, allCSRs);
+    csrs.reserved.assign(numSelectionSubframes, 0);
 
-    // subchannels disallowed
-    std::map < int, std::unordered_map < int, std::vector < int >> > aboveThresholdDisallowedIndices;
+    // CSRs disallowed by the RSRP threshold, by the number of 3dB threshold increases which would allow them again
+    std::map<int, std::vector<uint64_t>> aboveThresholdMasks;
+    // Number of disallowed CSRs counted at each number of increases (for all but the last selection subframe)
+    std::map<int, int> aboveThresholdCounts;
 
     int disallowedCSRs = 0;
 
@@ -734,7 +743,7 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
     int minSubCh = sensingWindowLength - fallBack;
 
     int z = minSubCh;
-    while (z <= sensingWindow_.size()) {
+    while (z <= sensingWindow_.getNumSubframes()) {
         // The use of z is to correspond with the notation in the standard see 3GPP TS 36.213 14.1.1.6
 
         int pRsvpTxPrime = pStep_ * pRsvpTx / 100;
@@ -744,7 +753,7 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
 
         int translatedZ = translateIndex(sensingWindowLength - z);
 
-        if (!sensingWindow_[translatedZ][0]->getSensed()) {
+        if (!sensingWindow_.getSensed(translatedZ, 0)) {
             /**
              *  Not sensed calculation
              *
@@ -772,19 +781,22 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
                 // This applies to all allowed RRIs as well.
                 // 10 * pStep_ = n'
 
-                if ((*k) < 1 && sensingWindowLength - z < pStep_ * (*k)) {
+                const std::vector<int>& offsets = rriOffsets_[allowedRRICodes[k - allowedRRIs.begin()]];
+
+                if ((*k) < 1 && sensingWindowLength - z < offsets[1]) {
                     Q = 1 / *k;
                 }
 
                 for (int q = 1; q <= Q; q++) {
-
-                    for (int j = 1; j <= cResel + 1; j++) {
-                        int disallowedSubframe = (z + (j * pRsvpTxPrime)) - (pStep_ * q * (*k));
-                        // Only mark as disallowed if it corresponds with a frame in the selection window
-                        if (disallowedSubframe >= minSelectionIndex && disallowedSubframe <= maxSelectionIndex) {
-                            notSensedSubframes.push_back(disallowedSubframe);
-                            disallowedCSRs += numSubchannels_ / grantLength;
+                    // Only the j for which the subframe falls in the selection window are considered
+                    int base = z - offsets[q];
+                    int first, last;
+                    if (findIndexRange(base, pRsvpTxPrime, 1, cResel + 1, minSelectionIndex, maxSelectionIndex, first, last)) {
+                        for (int j = first; j <= last; j++) {
+                            // The whole subframe is excluded
+                            csrs.possible[base + j * pRsvpTxPrime - minSelectionIndex] = 0;
                         }
+                        disallowedCSRs += (last - first + 1) * (numSubchannels_ / grantLength);
                     }
                 }
             }
@@ -816,7 +828,7 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
                 // An SCI and record the information for each independently for the later calculation
                 std::vector<double> averageRSRPs;
                 std::vector<int> priorities;
-                std::vector<double> rris;
+                std::vector<int> rris;
 
                 bool subchannelReserved = false;
                 bool subchannelUsed = false;
@@ -827,26 +839,20 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
 
                 int k = j;
                 while (k < j + grantLength) {
-                    if (sensingWindow_[translatedZ][k]->getReserved()) {
+                    if (sensingWindow_.getReserved(translatedZ, k)) {
                         // If RRI = 0 then we know the next resource is not reserved.
-                        int rri = sensingWindow_[translatedZ][k]->getResourceReservationInterval();
+                        int rri = sensingWindow_.getResourceReservationInterval(translatedZ, k);
                         if (rri > 0) {
                             subchannelReserved = true;
 
-                            priorities.push_back(sensingWindow_[translatedZ][k]->getPriority());
-                            if (rri == 11) {
-                                rris.push_back(0.5);
-                            } else if (rri == 12) {
-                                rris.push_back(0.2);
-                            } else {
-                                rris.push_back(rri);
-                            }
+                            priorities.push_back(sensingWindow_.getPriority(translatedZ, k));
+                            rris.push_back(rri);
                             double totalRSRPLinear = 0;
                             // Specifically the average should be for the part of the subchannel we will end up using
                             for (int l = j; l < j + grantLength; l++) {
-                                if (sensingWindow_[translatedZ][l]->getAverageRSRP() !=
+                                if (sensingWindow_.getAverageRSRP(translatedZ, l) !=
                                     -std::numeric_limits<double>::infinity()) {
-                                    totalRSRPLinear += dBmToLinear(sensingWindow_[translatedZ][l]->getAverageRSRP());
+                                    totalRSRPLinear += dBmToLinear(sensingWindow_.getAverageRSRP(translatedZ, l));
                                 }
                             }
                             if (totalRSRPLinear != 0) {
@@ -864,14 +870,14 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
 
                     int highestThreshold = 0;
                     bool thresholdBreach = false;
-                    double pRsvpRx;
+                    int pRsvpRx;
 
                     // Get the priorities of both messages
                     int messagePriority = grant->getSpsPriority();
                     for (int l = 0; l < averageRSRPs.size(); l++) {
                         double averageRSRP = averageRSRPs[l];
                         int receivedPriority = priorities[l];
-                        double receivedRri = rris[l];
+                        int receivedRri = rris[l];
 
                         // Get the threshold for the corresponding priorities
                         int index = messagePriority * 8 + receivedPriority + 1;
@@ -895,22 +901,35 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
 
                     if (thresholdBreach) {
                         // This series of subchannels is to be excluded
+                        const std::vector<int>& offsets = rriOffsets_[pRsvpRx];
                         int Q = 1;
-                        if (pRsvpRx < 1 && z <= sensingWindowLength - pStep_ * pRsvpRx) {
-                            Q = 1 / pRsvpRx;
+                        if (RRI_CODE_VALUES[pRsvpRx] < 1 && z <= sensingWindowLength - offsets[1]) {
+                            Q = 1 / RRI_CODE_VALUES[pRsvpRx];
                         }
 
+                        std::vector<uint64_t>& mask = aboveThresholdMasks[highestThreshold];
+                        if (mask.empty()) {
+                            mask.assign(numSelectionSubframes, 0);
+                        }
+                        int& count = aboveThresholdCounts[highestThreshold];
+
                         for (int q = 1; q <= Q; q++) {
                             // j replaced with c in this case as would disrupt above use of j
-                            for (int c = 0; c < cResel; c++) {
+                            // Only the c for which the subframe falls in the selection window are considered
+                            int base = z + offsets[q];
+                            int first, last;
+                            if (!findIndexRange(base, -pRsvpTxPrime, 0, cResel - 1, minSelectionIndex, maxSelectionIndex, first, last)) {
+                                continue;
+                            }
+                            for (int c = first; c <= last; c++) {
                                 // Based on above calc comment
-                                int disallowedIndex = (z + q * pStep_ * pRsvpRx) - (c * pRsvpTxPrime);
+                                int disallowedIndex = base - c * pRsvpTxPrime;
+                                mask[disallowedIndex - minSelectionIndex] |= (uint64_t)1 << (j / grantLength);
 
-                                // Only mark as disallowed if it corresponds with a frame in the selection window
-                                if (disallowedIndex >= minSelectionIndex && disallowedIndex <= maxSelectionIndex) {
-                                    aboveThresholdDisallowedIndices[highestThreshold][disallowedIndex].push_back(j);
-                                    ++disallowedCSRs;
+                                if (disallowedIndex < maxSelectionIndex) {
+                                    ++count;
                                 }
+                                ++disallowedCSRs;
                             }
                         }
                     }
@@ -926,19 +945,10 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
     // If too many CSRs are reserved need to reclaim some
     if (disallowedCSRs > totalPossibleCSRs * .8)
     {
-        std::map<int, std::unordered_map<int, std::vector<int>>>::const_iterator it;
-        for (it = aboveThresholdDisallowedIndices.begin(); it != aboveThresholdDisallowedIndices.end(); it++) {
-            int disallowedAtThisIncrease = 0;
-            for (int j = minSelectionIndex; j < maxSelectionIndex; j++) {
-
-                std::unordered_map<int, std::vector<int>>::const_iterator got = it->second.find(j);
-
-                if (got != it->second.end()) {
-                    disallowedAtThisIncrease += got->second.size();
-                }
-            }
+        std::map<int, int>::const_iterator it;
+        for (it = aboveThresholdCounts.begin(); it != aboveThresholdCounts.end(); it++) {
             // Remove CSRs counted at this increase.
-            disallowedCSRs -= disallowedAtThisIncrease;
+            disallowedCSRs -= it->second;
 
             // If we go below the 80% disallowed CSRs then mark it, these will have to be added back into possibleCSRs
             if (disallowedCSRs < totalPossibleCSRs * .8) {
@@ -949,54 +959,18 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
         }
     }
 
-    // Need to remove all the not sensed subframes first
-    for (int i=0; i<notSensedSubframes.size(); i++)
-    {
-        int subframeIndex = notSensedSubframes[i];
-        if ( possibleCSRs.find(subframeIndex) != possibleCSRs.end() ) {
-            // Simply erase this element as an option.
-            possibleCSRs.erase(subframeIndex);
-        }
-    }
-
-    // Maintain list of CSRs which are currently reserved but still possible
-    std::unordered_map<int, std::unordered_map<int, bool>> reservedCSRs;
-
     // Now need to go through all the threshold breaking CSRs and remove them
-    std::map<int, std::unordered_map<int, std::vector<int>>>::const_iterator it;
-    for (it = aboveThresholdDisallowedIndices.begin(); it != aboveThresholdDisallowedIndices.end(); it++) {
-
-        // Ignore those that we have to keep due to increased thresholds
-        if (it->first > minThresholdIncreasesRequired)
-        {
-            // Go through each subframe in this threshold
-            std::unordered_map<int, std::vector<int>>::const_iterator jt;
-            for (jt=it->second.begin(); jt!=it->second.end(); jt++) {
-
-                // Go through each subchannel in this threshold
-                std::vector<int>::const_iterator kt;
-                for (kt=jt->second.begin(); kt!=jt->second.end(); kt++){
-                    // Erase the subchannel
-                    possibleCSRs[jt->first].erase(*kt);
-
-                    if (possibleCSRs[jt->first].size() == 0){
-                        // If the subframe is now empty then erase it also.
-                        possibleCSRs.erase(jt->first);
-                    }
-                }
+    std::map<int, std::vector<uint64_t>>::const_iterator it;
+    for (it = aboveThresholdMasks.begin(); it != aboveThresholdMasks.end(); it++) {
+        const std::vector<uint64_t>& mask = it->second;
+        if (it->first > minThresholdIncreasesRequired) {
+            for (int i = 0; i < numSelectionSubframes; i++) {
+                csrs.possible[i] &= ~mask[i];
             }
         } else {
-            // Mark those we kept due to increased thresholds
-            // Go through each subframe in this threshold
-            std::unordered_map<int, std::vector<int>>::const_iterator jt;
-            for (jt=it->second.begin(); jt!=it->second.end(); jt++) {
-
-                // Go through each subchannel in this threshold
-                std::vector<int>::const_iterator kt;
-                for (kt=jt->second.begin(); kt!=jt->second.end(); kt++){
-                    // mark the subchannel as reserved
-                    reservedCSRs[jt->first][*kt] = true;
-                }
+            // Mark those we kept due to increased thresholds as reserved
+            for (int i = 0; i < numSelectionSubframes; i++) {
+                csrs.reserved[i] |= mask[i];
             }
         }
     }
@@ -1008,31 +982,21 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
     std::vector<std::tuple<double, int, int, bool>> optimalCSRs;
 
     if (rssiFiltering_) {
-        optimalCSRs = selectBestRSSIs(possibleCSRs, grant, totalPossibleCSRs, reservedCSRs);
+        optimalCSRs = selectBestRSSIs(csrs, grant, totalPossibleCSRs);
     } else if (rsrpFiltering_) {
-        optimalCSRs = selectBestRSRPs(possibleCSRs, grant, totalPossibleCSRs, reservedCSRs);
+        optimalCSRs = selectBestRSRPs(csrs, grant, totalPossibleCSRs);
     } else {
         // Simply convert the possible CSRs to the correct format and shuffle them and return 20% of them as normal.
         std::vector <std::tuple<double, int, int, bool>> orderedCSRs;
-        std::unordered_map < int, std::set < int >> ::iterator
-        it;
-
-        for (it = possibleCSRs.begin(); it != possibleCSRs.end(); it++) {
-            int subframe = it->first;
-            std::set<int>::iterator jt;
-            for (jt = it->second.begin(); jt != it->second.end(); jt++) {
-                int sensingSubframeIndex = subframe;
-                int initialSubchannelIndex = *jt;
-                int finalSubchannelIndex = *jt + grantLength;
-                bool reserved = false;
-
-                for (int i = initialSubchannelIndex; i < finalSubchannelIndex; i++){
-                    if (reservedCSRs.find(subframe) != reservedCSRs.end()){
-                        if (reservedCSRs[subframe].find(i) != reservedCSRs[subframe].end()){
-                            reserved = true;
-                        }
-                    }
+
+        for (int i = 0; i < numSelectionSubframes; i++) {
+            int subframe = minSelectionIndex + i;
+            for (int b = 0; b < csrsPerSubframe; b++) {
+                if (!((csrs.possible[i] >> b) & 1)) {
+                    continue;
                 }
+                int initialSubchannelIndex = b * grantLength;
+                bool reserved = (csrs.reserved[i] >> b) & 1;
 
                 // Subchannel has never been reserved and thus has negative infinite RSSI.
                 int transIndex = subframe - sensingWindowLength;
@@ -1057,8 +1021,8 @@ void LtePhyVUeMode4::computeCSRs(LteMode4SchedulingGrant* &grant) {
     send(candidateResourcesMessage, upperGateOut_);
 }
 
-std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSSIs(std::unordered_map<int, std::set<int>> possibleCSRs,
-        LteMode4SchedulingGrant* &grant, int totalPossibleCSRs, std::unordered_map<int, std::unordered_map<int, bool>> reservedCSRs)
+std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSSIs(const CsrBitmap& csrs,
+        LteMode4SchedulingGrant* &grant, int totalPossibleCSRs)
 {
     EV << NOW << " LtePhyVUeMode4::selectBestRSSIs - Selecting best CSRs from possible CSRs..." << endl;
     int decrease = pStep_;
@@ -1083,26 +1047,21 @@ std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSSIs(
 
     // This will be avgRSSI -> (subframeIndex, subchannelIndex)
     std::vector<std::tuple<double, int, int, bool>> orderedCSRs;
-    std::unordered_map<int, std::set<int>>::iterator it;
+    int csrsPerSubframe = numSubchannels_ / grantLength;
 
-    for (it=possibleCSRs.begin(); it!=possibleCSRs.end(); it++)
+    for (int i = 0; i < csrs.possible.size(); i++)
     {
-        int subframe = it->first;
-        std::set<int>::iterator jt;
-        for (jt=it->second.begin(); jt!=it->second.end(); jt++)
+        int subframe = csrs.firstSubframe + i;
+        for (int b = 0; b < csrsPerSubframe; b++)
         {
-            int sensingSubframeIndex = subframe;
-            int initialSubchannelIndex = *jt;
-            int finalSubchannelIndex = *jt + grantLength;
-            bool reserved = false;
-
-            for (int i = initialSubchannelIndex; i < finalSubchannelIndex; i++){
-                if (reservedCSRs.find(subframe) != reservedCSRs.end()){
-                    if (reservedCSRs[subframe].find(i) != reservedCSRs[subframe].end()){
-                        reserved = true;
-                    }
-                }
+            if (!((csrs.possible[i] >> b) & 1))
+            {
+                continue;
             }
+            int sensingSubframeIndex = subframe;
+            int initialSubchannelIndex = b * grantLength;
+            int finalSubchannelIndex = initialSubchannelIndex + grantLength;
+            bool reserved = (csrs.reserved[i] >> b) & 1;
 
             while (sensingSubframeIndex > sensingWindowLength){
                 // decrease the subframe index until we are within the sensing window.
@@ -1116,9 +1075,9 @@ std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSSIs(
                 int translatedSubframeIndex = translateIndex(sensingWindowLength - sensingSubframeIndex);
                 for (int subchannelCounter = initialSubchannelIndex; subchannelCounter < finalSubchannelIndex; subchannelCounter++)
                 {
-                    if (sensingWindow_[translatedSubframeIndex][subchannelCounter]->getSensed())
+                    if (sensingWindow_.getSensed(translatedSubframeIndex, subchannelCounter))
                     {
-                        double averageRSSI = dBmToLinear(sensingWindow_[translatedSubframeIndex][subchannelCounter]->getAverageRSSI());
+                        double averageRSSI = dBmToLinear(sensingWindow_.getAverageRSSI(translatedSubframeIndex, subchannelCounter));
                         if (averageRSSI != -std::numeric_limits<double>::infinity()){
                             totalRSSI += averageRSSI;
                             ++numSubchannels;
@@ -1163,8 +1122,8 @@ std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSSIs(
     return orderedCSRs;
 }
 
-std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSRPs(std::unordered_map<int, std::set<int>> possibleCSRs,
-        LteMode4SchedulingGrant* &grant, int totalPossibleCSRs, std::unordered_map<int, std::unordered_map<int, bool>> reservedCSRs)
+std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSRPs(const CsrBitmap& csrs,
+        LteMode4SchedulingGrant* &grant, int totalPossibleCSRs)
 {
     EV << NOW << " LtePhyVUeMode4::selectBestRSSIs - Selecting best CSRs from possible CSRs..." << endl;
     int decrease = pStep_;
@@ -1189,26 +1148,21 @@ std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSRPs(
 
     // This will be avgRSSI -> (subframeIndex, subchannelIndex)
     std::vector<std::tuple<double, int, int, bool>> orderedCSRs;
-    std::unordered_map<int, std::set<int>>::iterator it;
+    int csrsPerSubframe = numSubchannels_ / grantLength;
 
-    for (it=possibleCSRs.begin(); it!=possibleCSRs.end(); it++)
+    for (int i = 0; i < csrs.possible.size(); i++)
     {
-        int subframe = it->first;
-        std::set<int>::iterator jt;
-        for (jt=it->second.begin(); jt!=it->second.end(); jt++)
+        int subframe = csrs.firstSubframe + i;
+        for (int b = 0; b < csrsPerSubframe; b++)
         {
-            int sensingSubframeIndex = subframe;
-            int initialSubchannelIndex = *jt;
-            int finalSubchannelIndex = *jt + grantLength;
-            bool reserved = false;
-
-            for (int i = initialSubchannelIndex; i < finalSubchannelIndex; i++){
-                if (reservedCSRs.find(subframe) != reservedCSRs.end()){
-                    if (reservedCSRs[subframe].find(i) != reservedCSRs[subframe].end()){
-                        reserved = true;
-                    }
-                }
+            if (!((csrs.possible[i] >> b) & 1))
+            {
+                continue;
             }
+            int sensingSubframeIndex = subframe;
+            int initialSubchannelIndex = b * grantLength;
+            int finalSubchannelIndex = initialSubchannelIndex + grantLength;
+            bool reserved = (csrs.reserved[i] >> b) & 1;
 
             while (sensingSubframeIndex > sensingWindowLength){
                 // decrease the subframe index until we are within the sensing window.
@@ -1222,9 +1176,9 @@ std::vector<std::tuple<double, int, int, bool>> LtePhyVUeMode4::selectBestRSRPs(
                 int translatedSubframeIndex = translateIndex(sensingWindowLength - sensingSubframeIndex);
                 for (int subchannelCounter = initialSubchannelIndex; subchannelCounter < finalSubchannelIndex; subchannelCounter++)
                 {
-                    if (sensingWindow_[translatedSubframeIndex][subchannelCounter]->getSensed())
+                    if (sensingWindow_.getSensed(translatedSubframeIndex, subchannelCounter))
                     {
-                        double averageRSRP = dBmToLinear(sensingWindow_[translatedSubframeIndex][subchannelCounter]->getAverageRSRP());
+                        double averageRSRP = dBmToLinear(sensingWindow_.getAverageRSRP(translatedSubframeIndex, subchannelCounter));
                         if (averageRSRP != -std::numeric_limits<double>::infinity()){
                             totalRSRP += averageRSRP;
                             ++numSubchannels;
@@ -1392,29 +1346,53 @@ LteAirFrame* LtePhyVUeMode4::prepareAirFrame(cMessage* msg, UserControlInfo* lte
     return frame;
 }
 
-void LtePhyVUeMode4::storeAirFrame(LteAirFrame* newFrame)
+void LtePhyVUeMode4::storeAirFrame(LteAirFrame* newFrame, UserControlInfo* newInfo)
+{
+    ReceivedFrame received;
+    received.frame = newFrame;
+    received.info = newInfo;
+    // size the record once for all bands, so that the channel model only writes in place
+    received.measurements = measurementPool_.acquire(binder_->getNumBands());
+    received.averageSinr = 0.0;
+
+    if (receptionStage_ == NULL)
+    {
+        measureAirFrame(received);
+    }
+    else if (!receptionPending_)
+    {
+        // measured later in this TTI, along with the frames of the other receivers
+        receptionStage_->addReceiver(this);
+        receptionPending_ = true;
+    }
+
+    if (newInfo->getFrameType() == SCIPKT){
+        sciInfo_.push_back(received);
+    }  else{
+        tbInfo_.push_back(received);
+    }
+}
+
+void LtePhyVUeMode4::measureAirFrame(ReceivedFrame& received)
 {
     // implements the capture effect
     // store the frame received from the nearest transmitter
-    UserControlInfo* newInfo = check_and_cast<UserControlInfo*>(newFrame->getControlInfo());
     Coord myCoord = getCoord();
 
-    std::tuple<std::vector<double>, double> rsrpAttenuation = channelModel_->getRSRP_D2D(newFrame, newInfo, nodeId_, myCoord);
-    std::vector<double> rsrpVector = get<0>(rsrpAttenuation);
-    double attenuation = get<1>(rsrpAttenuation);
+    BandMeasurements* measurements = received.measurements;
+    channelModel_->getRSRP_D2D(received.frame, received.info, nodeId_, myCoord, *measurements);
 
     // Seems we don't really actually need the enbId, I have set it to 0 as it is referenced but never used for calc
-    std::tuple<std::vector<double>, std::vector<double>> rssiSinrVectors = channelModel_->getRSSI_SINR(newFrame, newInfo, nodeId_, myCoord, 0, rsrpVector);
+    channelModel_->getRSSI_SINR(received.frame, received.info, nodeId_, myCoord, 0, *measurements);
 
-    std::vector<double> rssiVector = get<0>(rssiSinrVectors);
-    std::vector<double> sinrVector = get<1>(rssiSinrVectors);
+    const std::vector<double>& sinrVector = measurements->sinrVector;
 
     int countAssignedRbs = 0;
     double avgSinr = 0.0;
-    RbMap grantedBlocks = newInfo->getGrantedBlocks();
+    const RbMap& grantedBlocks = received.info->getGrantedBlocks();
 
-    RbMap::iterator it;
-    std::map<Band, unsigned int>::iterator jt;
+    RbMap::const_iterator it;
+    std::map<Band, unsigned int>::const_iterator jt;
     //for each Remote unit used to transmit the packet
     for (it = grantedBlocks.begin(); it != grantedBlocks.end(); ++it) {
         //for each logical band used to transmit the packet
@@ -1427,18 +1405,44 @@ void LtePhyVUeMode4::storeAirFrame(LteAirFrame* newFrame)
         }
     }
 
-    avgSinr = avgSinr / countAssignedRbs;
-
     // Need to be able to figure out which subchannel is associated to the Rbs in this case
-    if (newInfo->getFrameType() == SCIPKT){
-        sciInfo_.push_back(std::make_tuple(newFrame, rsrpVector, rssiVector, sinrVector, attenuation, avgSinr));
-    }  else{
-        tbInfo_.push_back(std::make_tuple(newFrame, rsrpVector, rssiVector, sinrVector, attenuation, avgSinr));
+    received.averageSinr = avgSinr / countAssignedRbs;
+}
+
+void LtePhyVUeMode4::prepareReceptions()
+{
+    PositionHistory& history = binder_->positionHistory;
+    // the jakes fading of a transmitter lives in its own channel model and is shared by its receivers
+    LteRealisticChannelModel* realisticModel = check_and_cast<LteRealisticChannelModel*>(channelModel_);
+    for (int i = 0; i < sciInfo_.size(); i++)
+    {
+        history.update(sciInfo_[i].info->getSourceId(), sciInfo_[i].info->getCoord());
+        history.getSpeed(sciInfo_[i].info->getSourceId(), sciInfo_[i].info->getCoord());
+        realisticModel->prepareJakesFading_D2D(sciInfo_[i].info->getSourceId(), sciInfo_[i].info->getCoord());
     }
+    for (int i = 0; i < tbInfo_.size(); i++)
+    {
+        history.update(tbInfo_[i].info->getSourceId(), tbInfo_[i].info->getCoord());
+        history.getSpeed(tbInfo_[i].info->getSourceId(), tbInfo_[i].info->getCoord());
+        realisticModel->prepareJakesFading_D2D(tbInfo_[i].info->getSourceId(), tbInfo_[i].info->getCoord());
+    }
+    receptionPending_ = false;
+}
+
+void LtePhyVUeMode4::measureReceptions()
+{
+    for (int i = 0; i < sciInfo_.size(); i++)
+        measureAirFrame(sciInfo_[i]);
+    for (int i = 0; i < tbInfo_.size(); i++)
+        measureAirFrame(tbInfo_[i]);
 }
 
-void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo, std::vector<double> &rsrpVector, std::vector<double> &rssiVector, std::vector<double> &sinrVector, double &attenuation)
+void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo, BandMeasurements& measurements)
 {
+    const std::vector<double>& rsrpVector = measurements.rsrpVector;
+    const std::vector<double>& rssiVector = measurements.rssiVector;
+    double attenuation = measurements.attenuation;
+
     EV << NOW << " LtePhyVUeMode4::decodeAirFrame - Start decoding..." << endl;
 
     // apply decider to received packet
@@ -1477,18 +1481,16 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
                 lteInfo->setDeciderResult(false);
                 sciUnsensed_ += 1;
             } else {
-                std::tuple<bool, bool> res = channelModel_->error_Mode4(frame, lteInfo, rsrpVector, sinrVector, 0);
+                std::tuple<bool, bool> res = channelModel_->error_Mode4(frame, lteInfo, measurements, 0);
                 prop_result = get<0>(res);
                 interference_result = get<1>(res);
 
-                RbMap::iterator mt;
-                std::map<Band, unsigned int>::iterator nt;
-                RbMap usedRbs = lteInfo->getGrantedBlocks();
-                std::vector < Subchannel * > currentSubframe = sensingWindow_[sensingWindowFront_];
-                Subchannel *currentSubchannel = currentSubframe[subchannelIndex];
-                std::vector<Band>::iterator lt;
-                std::vector <Band> allocatedBands = currentSubchannel->getOccupiedBands();
-                for (lt = allocatedBands.begin(); lt != allocatedBands.end(); lt++) {
+                RbMap::const_iterator mt;
+                std::map<Band, unsigned int>::const_iterator nt;
+                const RbMap& usedRbs = lteInfo->getGrantedBlocks();
+                Band firstBand = sensingWindow_.getFirstBand(subchannelIndex);
+                Band lastBand = firstBand + sensingWindow_.getNumBands(subchannelIndex);
+                for (Band lt = firstBand; lt < lastBand; lt++) {
                     // Record RSRP and RSSI for this band depending if it was used or not
                     bool used = false;
 
@@ -1496,9 +1498,9 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
                     for (mt = usedRbs.begin(); mt != usedRbs.end(); ++mt) {
                         //for each logical band used to transmit the packet
                         for (nt = mt->second.begin(); nt != mt->second.end(); ++nt) {
-                            if (nt->first == *lt) {
-                                currentSubchannel->addRsrpValue(rsrpVector[(*lt)], (*lt));
-                                currentSubchannel->addRssiValue(rssiVector[(*lt)], (*lt));
+                            if (nt->first == lt) {
+                                sensingWindow_.addRsrpValue(sensingWindowFront_, subchannelIndex, rsrpVector[lt], lt);
+                                sensingWindow_.addRssiValue(sensingWindowFront_, subchannelIndex, rssiVector[lt], lt);
                                 used = true;
                                 break;
                             }
@@ -1507,19 +1509,12 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
                 }
 
                 // Need to ensure that we haven't previously decoded a higher SINR packet.
-                if (interference_result & !sensingWindow_[sensingWindowFront_][subchannelIndex]->getReserved()) {
+                if (interference_result & !sensingWindow_.getReserved(sensingWindowFront_, subchannelIndex)) {
                     for (int i = subchannelIndex; i < subchannelIndex + lengthInSubchannels; i++) {
-                        Subchannel *currentSubchannel = currentSubframe[i];
                         // Record the SCI info in the subchannel.
-                        currentSubchannel->setPriority(sci->getPriority());
-                        currentSubchannel->setResourceReservationInterval(sci->getResourceReservationInterval());
-                        currentSubchannel->setFrequencyResourceLocation(sci->getFrequencyResourceLocation());
-                        currentSubchannel->setTimeGapRetrans(sci->getTimeGapRetrans());
-                        currentSubchannel->setMcs(sci->getMcs());
-                        currentSubchannel->setRetransmissionIndex(sci->getRetransmissionIndex());
-                        currentSubchannel->setSciSubchannelIndex(subchannelIndex);
-                        currentSubchannel->setSciLength(lengthInSubchannels);
-                        currentSubchannel->setReserved(true);
+                        sensingWindow_.setSciInfo(sensingWindowFront_, i, sci->getPriority(), sci->getResourceReservationInterval(),
+                                sci->getFrequencyResourceLocation(), sci->getTimeGapRetrans(), sci->getMcs(),
+                                sci->getRetransmissionIndex(), subchannelIndex, lengthInSubchannels);
                     }
                     lteInfo->setDeciderResult(true);
                     sciDecoded_ += 1;
@@ -1534,7 +1529,7 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
                 }
             }
             pkt->setControlInfo(lteInfo);
-            scis_.push_back(pkt);
+            scis_[lteInfo->getSourceId()].push_back(pkt);
         }
         else
         {
@@ -1558,32 +1553,27 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
             bool sciDecodedSuccessfully = false;
             SidelinkControlInformation *correspondingSCI;
             UserControlInfo *sciInfo;
-            std::vector<cPacket *>::iterator it;
-            for (it = scis_.begin(); it != scis_.end(); it++) {
-                sciInfo = check_and_cast<UserControlInfo*>((*it)->removeControlInfo());
-                // if the SCI and TB have same source then we have the right SCI
-                if (sciInfo->getSourceId() == lteInfo->getSourceId()) {
-                    //Successfully received the SCI
-                    foundCorrespondingSci = true;
-
-                    correspondingSCI = check_and_cast<SidelinkControlInformation*>(*it);
-
-                    if (sciInfo->getDeciderResult()) {
-                        sciDecodedSuccessfully = true;
-                    }
+            // if the SCI and TB have same source then we have the right SCI
+            std::unordered_map<MacNodeId, std::vector<cPacket*>>::iterator it = scis_.find(lteInfo->getSourceId());
+            if (it != scis_.end() && !it->second.empty()) {
+                //Successfully received the SCI
+                foundCorrespondingSci = true;
 
-                    if (lteInfo->getDirection() == D2D_MULTI) {
-                        std::tuple<bool, bool> res = channelModel_->error_Mode4(frame, lteInfo, rsrpVector, sinrVector, correspondingSCI->getMcs());
-                        prop_result = get<0>(res);
-                        interference_result = get<1>(res);
-                    }
+                correspondingSCI = check_and_cast<SidelinkControlInformation*>(it->second.front());
+                sciInfo = check_and_cast<UserControlInfo*>(correspondingSCI->removeControlInfo());
 
-                    // Remove the SCI
-                    scis_.erase(it);
-                    break;
-                } else {
-                    (*it)->setControlInfo(sciInfo);
+                if (sciInfo->getDeciderResult()) {
+                    sciDecodedSuccessfully = true;
+                }
+
+                if (lteInfo->getDirection() == D2D_MULTI) {
+                    std::tuple<bool, bool> res = channelModel_->error_Mode4(frame, lteInfo, measurements, correspondingSCI->getMcs());
+                    prop_result = get<0>(res);
+                    interference_result = get<1>(res);
                 }
+
+                // Remove the SCI
+                it->second.erase(it->second.begin());
             }
             if (!foundCorrespondingSci || !sciDecodedSuccessfully) {
                 tbFailedDueToNoSCI_ += 1;
@@ -1615,9 +1605,9 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
             }
             if (foundCorrespondingSci) {
                 // Need to get the map only for the RBs used for transmission
-                RbMap::iterator mt;
-                std::map<Band, unsigned int>::iterator nt;
-                RbMap usedRbs = lteInfo->getGrantedBlocks();
+                RbMap::const_iterator mt;
+                std::map<Band, unsigned int>::const_iterator nt;
+                const RbMap& usedRbs = lteInfo->getGrantedBlocks();
 
                 // Now need to find the associated Subchannels, record the RSRP and RSSI for the message and go from there.
                 // Need to again do the RIV steps
@@ -1625,12 +1615,10 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
                 int subchannelIndex = std::get<0>(indexAndLength);
                 int lengthInSubchannels = std::get<1>(indexAndLength);
 
-                std::vector <Subchannel *> currentSubframe = sensingWindow_[sensingWindowFront_];
                 for (int i = subchannelIndex; i < subchannelIndex + lengthInSubchannels; i++) {
-                    Subchannel *currentSubchannel = currentSubframe[i];
-                    std::vector<Band>::iterator lt;
-                    std::vector <Band> allocatedBands = currentSubchannel->getOccupiedBands();
-                    for (lt = allocatedBands.begin(); lt != allocatedBands.end(); lt++) {
+                    Band firstBand = sensingWindow_.getFirstBand(i);
+                    Band lastBand = firstBand + sensingWindow_.getNumBands(i);
+                    for (Band lt = firstBand; lt < lastBand; lt++) {
                         // Record RSRP and RSSI for this band depending if it was used or not
                         bool used = false;
 
@@ -1638,9 +1626,9 @@ void LtePhyVUeMode4::decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo
                         for (mt = usedRbs.begin(); mt != usedRbs.end(); ++mt) {
                             //for each logical band used to transmit the packet
                             for (nt = mt->second.begin(); nt != mt->second.end(); ++nt) {
-                                if (nt->first == *lt) {
-                                    currentSubchannel->addRsrpValue(rsrpVector[(*lt)], (*lt));
-                                    currentSubchannel->addRssiValue(rssiVector[(*lt)], (*lt));
+                                if (nt->first == lt) {
+                                    sensingWindow_.addRsrpValue(sensingWindowFront_, i, rsrpVector[lt], lt);
+                                    sensingWindow_.addRssiValue(sensingWindowFront_, i, rssiVector[lt], lt);
                                     used = true;
                                     break;
                                 }
@@ -1748,40 +1736,37 @@ std::tuple<int,int> LtePhyVUeMode4::decodeRivValue(SidelinkControlInformation* s
     return std::make_tuple(subchannelIndex, lengthInSubchannels);
 }
 
-void LtePhyVUeMode4::updateCBR()
+void LtePhyVUeMode4::recordMissingTb()
 {
-    double cbrValue = 0.0;
-    double cbrPscchValue = 0.0;
-
-    int cbrIndex = sensingWindowFront_ - 1;
-    int cbrCount = 0;
-    int totalSubchannels = 0;
-
-    if (sensingWindow_.size() > 99){
-        cbrCount = 99;
-    } else{
-        cbrCount = sensingWindow_.size();
-    }
+    emit(txRxDistanceTB, -1);
+    emit(tbReceived, -1);
+    emit(tbDecoded, -1);
+    emit(tbFailedDueToNoSCI, -1);
+    emit(tbFailedDueToProp, -1);
+    emit(tbFailedDueToInterference, -1);
+    emit(tbFailedButSCIReceived, -1);
+    emit(tbFailedHalfDuplex, -1);
+    emit(periodic, -1);
+
+    emit(tbFailedDueToPropIgnoreSCI ,-1);
+    emit(tbFailedDueToInterferenceIgnoreSCI ,-1);
+    emit(tbDecodedIgnoreSCI ,-1);
+}
 
-    while (cbrCount > 0){
-        if (cbrIndex == -1){
-            cbrIndex = sensingWindow_.size() - 1;
-        }
-        std::vector<Subchannel *>::iterator it;
-        std::vector <Subchannel *> currentSubframe = sensingWindow_[cbrIndex];
-        for (it = currentSubframe.begin(); it != currentSubframe.end(); it++) {
-            if ((*it)->getSensed()) {
-                totalSubchannels++;
-                if ((*it)->getAverageRSSI() > thresholdRSSI_) {
-                    cbrValue++;
-                }
-                if ((*it)->getAverageRSSIPscch() > thresholdRSSI_) {
-                    cbrPscchValue++;
-                }
-            }
-        }
-        cbrIndex --;
-        cbrCount --;
+void LtePhyVUeMode4::updateCBR()
+{
+    // The counters cover the last 99 subframes before the front (or all but the front for a shorter sensing window)
+    int totalSubchannels = cbrSensedTotal_;
+    double cbrValue = cbrBusyTotal_;
+    double cbrPscchValue = cbrBusyPscchTotal_;
+
+    if (sensingWindow_.getNumSubframes() <= 99){
+        // The whole sensing window is used, including the subframe currently being sensed
+        int sensed, busy, busyPscch;
+        sensingWindow_.countBusy(sensingWindowFront_, thresholdRSSI_, sensed, busy, busyPscch);
+        totalSubchannels += sensed;
+        cbrValue += busy;
+        cbrPscchValue += busyPscch;
     }
 
     cbrValue = cbrValue / totalSubchannels;
@@ -1795,6 +1780,24 @@ void LtePhyVUeMode4::updateCBR()
     send(cbrPkt, upperGateOut_);
 }
 
+void LtePhyVUeMode4::updateCbrCounters()
+{
+    // Only the front subframe is ever modified, so its counters are final once it is left behind
+    if (cbrWindowLength_ == 0)
+        return;
+
+    int leaving = translateIndex(cbrWindowLength_);
+    cbrSensedTotal_ -= cbrSensed_[leaving];
+    cbrBusyTotal_ -= cbrBusy_[leaving];
+    cbrBusyPscchTotal_ -= cbrBusyPscch_[leaving];
+
+    sensingWindow_.countBusy(sensingWindowFront_, thresholdRSSI_, cbrSensed_[sensingWindowFront_],
+            cbrBusy_[sensingWindowFront_], cbrBusyPscch_[sensingWindowFront_]);
+    cbrSensedTotal_ += cbrSensed_[sensingWindowFront_];
+    cbrBusyTotal_ += cbrBusy_[sensingWindowFront_];
+    cbrBusyPscchTotal_ += cbrBusyPscch_[sensingWindowFront_];
+}
+
 void LtePhyVUeMode4::recordAwareness()
 {
     double totalNeighbours      = 0.0;
@@ -1867,15 +1870,20 @@ std::vector<MacNodeId> LtePhyVUeMode4::getNeighbours()
 
 void LtePhyVUeMode4::updateSubframe()
 {
-    // Ensure for every 1ms we record the position of the vehicle
-    emit(posX, getCoord().x);
-    emit(posY, getCoord().y);
+    // A transmission started in the previous subframe goes on the air in this one
+    transmitting_ = false;
+    if (beginTransmission_){
+        transmitting_ = true;
+        beginTransmission_ = false;
+    }
 
     int sensingWindowLength = pStep_ * 10;
     if (sensingWindowSizeOverride_ > 0){
         sensingWindowLength = sensingWindowSizeOverride_;
     }
 
+    updateCbrCounters();
+
     // Increment the pointer to the next element in the sensingWindow
     if (sensingWindowFront_ < sensingWindowLength - 1) {
         ++sensingWindowFront_;
@@ -1891,20 +1899,23 @@ void LtePhyVUeMode4::updateSubframe()
     // If it is occupied, pop it off, update it and push it back
     // All good then.
 
-    std::vector<Subchannel*> subframe = sensingWindow_[sensingWindowFront_];
-
-    if (subframe.at(0)->getSubframeTime() <= NOW - SimTime(sensingWindowLength, SIMTIME_MS) - TTI)
+    if (sensingWindow_.getSubframeTime(sensingWindowFront_) <= lastSubframeUpdate_ - SimTime(sensingWindowLength, SIMTIME_MS) - TTI)
     {
-        std::vector<Subchannel*>::iterator it;
-        for (it=subframe.begin(); it!=subframe.end(); it++)
-        {
-            (*it)->reset(NOW - TTI);
-        }
+        sensingWindow_.reset(sensingWindowFront_, lastSubframeUpdate_ - TTI);
     }
+}
+
+void LtePhyVUeMode4::advanceSensingWindow()
+{
+    if (lastSubframeUpdate_ + TTI > NOW)
+        return;
 
-    cMessage* updateSubframe = new cMessage("updateSubframe");
-    updateSubframe->setSchedulingPriority(0);        // Generate the subframe at start of next TTI
-    scheduleAt(NOW + TTI, updateSubframe);
+    // Catch up with the subframes elapsed since the window was last used, in order
+    while (lastSubframeUpdate_ + TTI <= NOW)
+    {
+        lastSubframeUpdate_ += TTI;
+        updateSubframe();
+    }
 }
 
 void LtePhyVUeMode4::initialiseSensingWindow()
@@ -1918,45 +1929,75 @@ void LtePhyVUeMode4::initialiseSensingWindow()
         sensingWindowLength = sensingWindowSizeOverride_;
     }
 
-    // Reserve the full size of the sensing window (might improve efficiency).
-    sensingWindow_.reserve(sensingWindowLength);
+    Band band = 0;
 
-    while(sensingWindow_.size() < sensingWindowLength)
+    if (!adjacencyPSCCHPSSCH_)
     {
-        std::vector<Subchannel*> subframe;
-        subframe.reserve(numSubchannels_);
-        Band band = 0;
-
-        if (!adjacencyPSCCHPSSCH_)
-        {
-            // This assumes the bands only every have 1 Rb (which is fine as that appears to be the case)
-            band = numSubchannels_*2;
-        }
-        for (int i = 0; i < numSubchannels_; i++) {
-            Subchannel *currentSubchannel = new Subchannel(subchannelSize_, subframeTime);
-            // Need to determine the RSRP and RSSI that corresponds to background noise
-            // Best off implementing this in the channel model as a method.
-
-            std::vector <Band> occupiedBands;
-
-            int overallCapacity = 0;
-            // Ensure the subchannel is allocated the correct number of RBs
-            while (overallCapacity < subchannelSize_ && band < getBinder()->getNumBands()) {
-                // This acts like there are multiple RBs per band which is not allowed.
-                occupiedBands.push_back(band);
-                ++overallCapacity;
-                ++band;
-            }
-            currentSubchannel->setOccupiedBands(occupiedBands);
-            subframe.push_back(currentSubchannel);
+        // This assumes the bands only every have 1 Rb (which is fine as that appears to be the case)
+        band = numSubchannels_*2;
+    }
+    Band startingBand = band;
+
+    // The band layout is the same in every subframe, so it is computed once here.
+    std::vector<int> bandsPerSubchannel;
+    bandsPerSubchannel.reserve(numSubchannels_);
+    for (int i = 0; i < numSubchannels_; i++) {
+        int overallCapacity = 0;
+        // Ensure the subchannel is allocated the correct number of RBs
+        while (overallCapacity < subchannelSize_ && band < getBinder()->getNumBands()) {
+            // This acts like there are multiple RBs per band which is not allowed.
+            ++overallCapacity;
+            ++band;
         }
-        sensingWindow_.push_back(subframe);
-        subframeTime += TTI;
+        bandsPerSubchannel.push_back(overallCapacity);
+    }
+    sensingWindow_.initialise(sensingWindowLength, numSubchannels_, subchannelSize_, startingBand, bandsPerSubchannel, subframeTime);
+
+    // CBR is measured over the last 100 subframes, the front one being counted separately
+    cbrWindowLength_ = std::min(99, sensingWindowLength - 1);
+    cbrSensed_.assign(sensingWindowLength, 0);
+    cbrBusy_.assign(sensingWindowLength, 0);
+    cbrBusyPscch_.assign(sensingWindowLength, 0);
+    cbrSensedTotal_ = 0;
+    cbrBusyTotal_ = 0;
+    cbrBusyPscchTotal_ = 0;
+    for (int i = 0; i < sensingWindowLength; i++)
+    {
+        sensingWindow_.countBusy(i, thresholdRSSI_, cbrSensed_[i], cbrBusy_[i], cbrBusyPscch_[i]);
     }
-    // Send self message to trigger another subframes creation and insertion. Need one for every TTI
-    cMessage* updateSubframe = new cMessage("updateSubframe");
-    updateSubframe->setSchedulingPriority(0);        // Generate the subframe at start of next TTI
-    scheduleAt(NOW + TTI, updateSubframe);
+    for (int i = 1; i <= cbrWindowLength_; i++)
+    {
+        int index = translateIndex(i);
+        cbrSensedTotal_ += cbrSensed_[index];
+        cbrBusyTotal_ += cbrBusy_[index];
+        cbrBusyPscchTotal_ += cbrBusyPscch_[index];
+    }
+
+    // The following subframes are created when the window is next used, no per-TTI event is needed
+    lastSubframeUpdate_ = NOW;
+
+    // Report the CBR at the start of the subframe the countdown expires in, then every 100ms
+    cbrTimer_ = new cMessage("cbrTimer");
+    cbrTimer_->setSchedulingPriority(0);
+    scheduleAt(NOW + TTI * (cbrCountDown_ + 1), cbrTimer_);
+
+    // Positions are recorded from the first subframe on, as the per-TTI update used to
+    if (positionRecordingInterval_ > 0)
+    {
+        positionTimer_ = new cMessage("positionTimer");
+        positionTimer_->setSchedulingPriority(0);
+        scheduleAt(NOW + TTI, positionTimer_);
+    }
+}
+
+int LtePhyVUeMode4::getRRICode(double rri)
+{
+    for (int code = 1; code < NUM_RRI_CODES; code++)
+    {
+        if (RRI_CODE_VALUES[code] == rri)
+            return code;
+    }
+    throw cRuntimeError("LtePhyVUeMode4::getRRICode - %g is not a valid resource reservation interval", rri);
 }
 
 int LtePhyVUeMode4::translateIndex(int fallBack) {
@@ -1986,6 +2027,10 @@ void LtePhyVUeMode4::finish()
             amc->detachUser(nodeId_, D2D);
         }
 
+        // the reception stage must not measure the frames of a deleted receiver
+        if (receptionPending_)
+            receptionStage_->removeReceiver(this);
+
         // binder call
         binder_->unregisterNextHop(masterId_, nodeId_);
 
@@ -1993,14 +2038,6 @@ void LtePhyVUeMode4::finish()
         deployer_->detachUser(nodeId_);
     }
 
-    std::vector<std::vector<Subchannel *>>::iterator it;
-    for (it=sensingWindow_.begin();it!=sensingWindow_.end();it++)
-    {
-        std::vector<Subchannel *>::iterator jt;
-        for (jt=it->begin();jt!=it->end();jt++)
-        {
-            delete (*jt);
-        }
-    }
-    sensingWindow_.clear();
+    recordScalar("measurementAllocations", measurementPool_.getAllocations());
+    recordScalar("measurementAllocationsPerDecodedTb", decodedTbs_ > 0 ? (double)measurementPool_.getAllocations() / decodedTbs_ : 0.0);
 }
@@ -14,13 +14,29 @@
 #include "stack/phy/packet/SidelinkControlInformation_m.h"
 #include "stack/mac/packet/LteSchedulingGrant.h"
 #include "stack/mac/allocator/LteAllocationModule.h"
-#include "stack/phy/layer/Subchannel.h"
+#include "stack/phy/layer/SensingWindow.h"
+#include "common/CounterRng.h"
 #include <unordered_map>
 
+class Mode4ReceptionStage;
+
 class LtePhyVUeMode4 : public LtePhyUeD2D
 {
   protected:
 
+    /**
+     * Candidate single-subframe resources (CSRs) of a selection window.
+     * Each subframe has a bitmap of CSRs, bit b standing for the CSR
+     * starting at subchannel b * grantLength.
+     */
+    struct CsrBitmap
+    {
+        int firstSubframe;
+        int grantLength;
+        std::vector<uint64_t> possible;
+        std::vector<uint64_t> reserved;
+    };
+
     // D2D Tx Power
     double d2dTxPower_;
 
@@ -30,7 +46,14 @@ class LtePhyVUeMode4 : public LtePhyUeD2D
     int subchannelSize_ ;
     int selectionWindowStartingSubframe_;
     int thresholdRSSI_;
+    // subframes until the first CBR report, afterwards one is sent every 100 subframes
     int cbrCountDown_;
+    cMessage* cbrTimer_;
+    // reused timer emitting posX/posY, not scheduled if the interval is 0
+    cMessage* positionTimer_;
+    simtime_t positionRecordingInterval_;
+    // start time of the latest subframe the sensing window has been advanced to
+    simtime_t lastSubframeUpdate_;
     int sensingWindowSizeOverride_;
 
     bool transmitting_;
@@ -45,17 +68,54 @@ class LtePhyVUeMode4 : public LtePhyUeD2D
 
     std::vector<int> ThresPSSCHRSRPvector_;
 
+    // Offset in subframes of the q-th repetition of a reservation (q * pStep * RRI), by RRI code and q
+    std::vector<std::vector<int>> rriOffsets_;
+
     cMessage* d2dDecodingTimer_; // timer for triggering decoding at the end of the TTI. Started when the first airframe is received
 
-    std::vector<std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double>> tbInfo_;
+    /**
+     * Airframe received in the current TTI, stored until the end of the TTI
+     * together with its control info and the measurements taken on reception.
+     * The measurements are borrowed from measurementPool_ and given back after decoding.
+     */
+    struct ReceivedFrame
+    {
+        LteAirFrame* frame;
+        UserControlInfo* info;
+        BandMeasurements* measurements;
+        double averageSinr;
+    };
+
+    std::vector<ReceivedFrame> tbInfo_;
+
+    std::vector<ReceivedFrame> sciInfo_;
 
-    std::vector<std::tuple<LteAirFrame*, std::vector<double>, std::vector<double>, std::vector<double>, double, double>> sciInfo_;
+    // Number of TBs decoded
+    unsigned long decodedTbs_;
 
-    std::vector<std::vector<Subchannel*>> sensingWindow_;
+    // stage measuring the received frames of all receivers at once, NULL to measure them on reception
+    Mode4ReceptionStage* receptionStage_;
+    // true if frames are queued for the reception stage in this TTI
+    bool receptionPending_;
+    // private random stream of the channel model, used with the reception stage
+    CounterRng* receptionRng_;
+
+    SensingWindow sensingWindow_;
     int sensingWindowFront_;
+
+    // CBR counters of each subframe, taken when the subframe leaves the front of the sensing window
+    std::vector<int> cbrSensed_;
+    std::vector<int> cbrBusy_;
+    std::vector<int> cbrBusyPscch_;
+    // Sums of the counters above over the cbrWindowLength_ subframes preceding the front
+    int cbrWindowLength_;
+    int cbrSensedTotal_;
+    int cbrBusyTotal_;
+    int cbrBusyPscchTotal_;
     LteMode4SchedulingGrant* sciGrant_;
 
-    std::vector<cPacket*> scis_;
+    // SCIs decoded in the current TTI (with their control info attached), by source
+    std::unordered_map<MacNodeId, std::vector<cPacket*>> scis_;
 
     // SCI stats
     simsignal_t sciSent;
@@ -141,9 +201,10 @@ class LtePhyVUeMode4 : public LtePhyUeD2D
 
     LteAllocationModule* allocator_;
 
-    void storeAirFrame(LteAirFrame* newFrame);
+    void storeAirFrame(LteAirFrame* newFrame, UserControlInfo* newInfo);
+    void measureAirFrame(ReceivedFrame& received);
     LteAirFrame* extractAirFrame();
-    void decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo, std::vector<double> &rsrpVector, std::vector<double> &rssiVector, std::vector<double> &sinrVector, double &attenuation);
+    void decodeAirFrame(LteAirFrame* frame, UserControlInfo* lteInfo, BandMeasurements& measurements);
     // ---------------------------------------------------------------- //
 
     virtual void initialize(int stage);
@@ -165,18 +226,40 @@ class LtePhyVUeMode4 : public LtePhyUeD2D
 
     virtual void computeRandomCSRs(LteMode4SchedulingGrant* &grant);
 
+    /*
+     * Moves the sensing window on by one subframe, starting at lastSubframeUpdate_
+     */
     virtual void updateSubframe();
 
-    virtual std::vector<std::tuple<double, int, int, bool>> selectBestRSSIs(std::unordered_map<int, std::set<int>> possibleCSRs,
-            LteMode4SchedulingGrant* &grant, int totalPossibleCSRs, std::unordered_map<int, std::unordered_map<int, bool>> reservedCSRs);
+    /*
+     * Brings the sensing window up to the current subframe. The window is only advanced
+     * when it is used (frame decoding, grants and CSRs, CBR), so an idle UE schedules
+     * no per-TTI event.
+     */
+    void advanceSensingWindow();
 
-    virtual std::vector<std::tuple<double, int, int, bool>> selectBestRSRPs(std::unordered_map<int, std::set<int>> possibleCSRs,
-            LteMode4SchedulingGrant* &grant, int totalPossibleCSRs, std::unordered_map<int, std::unordered_map<int, bool>> reservedCSRs);
+    virtual std::vector<std::tuple<double, int, int, bool>> selectBestRSSIs(const CsrBitmap& csrs,
+            LteMode4SchedulingGrant* &grant, int totalPossibleCSRs);
+
+    virtual std::vector<std::tuple<double, int, int, bool>> selectBestRSRPs(const CsrBitmap& csrs,
+            LteMode4SchedulingGrant* &grant, int totalPossibleCSRs);
 
     virtual std::tuple<int,int> decodeRivValue(SidelinkControlInformation* sci, UserControlInfo* sciInfo);
 
+    // Returns the SCI RRI code (1-12) of a reservation interval expressed in multiples of 100 ms
+    virtual int getRRICode(double rri);
+
+    // Records a TB which was announced by an SCI but not received
+    virtual void recordMissingTb();
+
     virtual void updateCBR();
 
+    /**
+     * Moves the CBR counters forward by one subframe. Must be called before
+     * the front of the sensing window is advanced.
+     */
+    virtual void updateCbrCounters();
+
     virtual void recordAwareness();
 
     virtual std::vector<MacNodeId> getNeighbours();
@@ -189,6 +272,18 @@ class LtePhyVUeMode4 : public LtePhyUeD2D
     LtePhyVUeMode4();
     virtual ~LtePhyVUeMode4();
 
+    /**
+     * Called by the reception stage, in the simulation thread, before measureReceptions():
+     * records the positions of the transmitters of the queued frames and computes their jakes fading
+     */
+    void prepareReceptions();
+
+    /**
+     * Called by the reception stage, possibly on a worker thread:
+     * measures the frames queued in this TTI
+     */
+    void measureReceptions();
+
     virtual double getTxPwr(Direction dir = UNKNOWN_DIRECTION)
     {
         if (dir == D2D)
@@ -0,0 +1,72 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef MODE4RESERVATIONS_H_
+#define MODE4RESERVATIONS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/*
+ * Resource reservation intervals of the Mode 4 sensing procedure (3GPP TS 36.213 14.1.1.6),
+ * used by LtePhyVUeMode4::computeCSRs to exclude the candidate resources of the selection window.
+ */
+
+// Resource reservation interval (in multiples of 100 subframes) of each SCI RRI code, 11 and 12 being 50 and 20 subframes
+static const double RRI_CODE_VALUES[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0.5, 0.2};
+static const int NUM_RRI_CODES = sizeof(RRI_CODE_VALUES) / sizeof(RRI_CODE_VALUES[0]);
+// Highest number of repetitions Q of a reservation in the sensing window (1/0.2)
+static const int MAX_RRI_REPETITIONS = 5;
+
+/*
+ * Fills offsets with the subframe offset q * pStep * RRI of the q-th repetition of a
+ * reservation, by RRI code and q
+ */
+inline void computeRriOffsets(int pStep, std::vector<std::vector<int> >& offsets)
+{
+    offsets.resize(NUM_RRI_CODES);
+    for (int code = 0; code < NUM_RRI_CODES; code++)
+    {
+        offsets[code].resize(MAX_RRI_REPETITIONS + 1);
+        for (int q = 0; q <= MAX_RRI_REPETITIONS; q++)
+            offsets[code][q] = (int)round(pStep * q * RRI_CODE_VALUES[code]);
+    }
+}
+
+/*
+ * Finds the range [first, last] of the indices i in [iMin, iMax] for which base + i * step
+ * lies within [minIndex, maxIndex]. Returns false if there is none.
+ */
+inline bool findIndexRange(int base, int step, int iMin, int iMax, int minIndex, int maxIndex, int& first, int& last)
+{
+    if (step == 0)
+    {
+        first = iMin;
+        last = iMax;
+        return base >= minIndex && base <= maxIndex && first <= last;
+    }
+    // Bounds of step * i, rounded inwards whatever the signs
+    int low = minIndex - base;
+    int high = maxIndex - base;
+    if (step < 0)
+    {
+        step = -step;
+        int tmp = low;
+        low = -high;
+        high = -tmp;
+    }
+    int lowIndex = low / step + ((low % step != 0 && low > 0) ? 1 : 0);
+    int highIndex = high / step - ((high % step != 0 && high < 0) ? 1 : 0);
+    first = std::max(iMin, lowIndex);
+    last = std::min(iMax, highIndex);
+    return first <= last;
+}
+
+#endif /* MODE4RESERVATIONS_H_ */
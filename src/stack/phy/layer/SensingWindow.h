@@ -0,0 +1,330 @@
+//
+//                           SimuLTE
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". This license can be also found at http://www.ltesimulator.com/
+// The above file and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef SENSINGWINDOW_H_
+#define SENSINGWINDOW_H_
+
+#include <algorithm>
+#include <limits>
+#include "common/LteCommon.h"
+
+/**
+ * Sensing window of a Mode 4 UE.
+ *
+ * The window is a ring of subframes, each holding numSubchannels subchannels.
+ * All per-subchannel fields are stored in flat arrays indexed by
+ * (subframe * numSubchannels + subchannel), and the RSRP/RSSI measurements
+ * in a fixed number of per-band slots after that, so that scans over the
+ * window walk contiguous memory and no allocation happens after initialise().
+ *
+ * The band occupancy is the same for every subframe, so it is only kept once
+ * per subchannel as a contiguous range [firstBand, firstBand + numBands).
+ * An unmeasured band is marked with -infinity.
+ */
+class SensingWindow
+{
+    protected:
+        int numSubframes;
+        int numSubchannels;
+        int numRbs;
+
+        std::vector<simtime_t> subframeTime;
+
+        std::vector<Band> firstBand;
+        std::vector<int> numBands;
+
+        std::vector<bool> sensed;
+        std::vector<bool> reserved;
+        std::vector<int> priority;
+        std::vector<int> resourceReservationInterval;
+        std::vector<int> frequencyResourceLocation;
+        std::vector<int> timeGapRetrans;
+        std::vector<int> mcs;
+        std::vector<int> retransmissionIndex;
+        std::vector<int> sciSubchannelIndex;
+        std::vector<int> sciLength;
+
+        std::vector<double> rsrpValues;
+        std::vector<double> rssiValues;
+
+        int index(int subframe, int subchannel) const
+        {
+            return subframe * numSubchannels + subchannel;
+        }
+        int bandIndex(int subframe, int subchannel) const
+        {
+            return index(subframe, subchannel) * numRbs;
+        }
+
+    public:
+        SensingWindow()
+        {
+            numSubframes = 0;
+            numSubchannels = 0;
+            numRbs = 0;
+        }
+
+        /**
+         * Sizes the window and marks every subchannel as sensed and free.
+         * Subframe i gets the time firstSubframeTime + i * TTI.
+         *
+         * @param bandsPerSubchannel the number of bands actually mapped to each
+         *        subchannel (at most subchannelSize)
+         */
+        void initialise(int windowLength, int subchannels, int subchannelSize, Band startingBand,
+                const std::vector<int>& bandsPerSubchannel, simtime_t firstSubframeTime)
+        {
+            numSubframes = windowLength;
+            numSubchannels = subchannels;
+            numRbs = subchannelSize;
+
+            firstBand.assign(numSubchannels, 0);
+            numBands.assign(numSubchannels, 0);
+            Band band = startingBand;
+            for (int i = 0; i < numSubchannels; i++)
+            {
+                firstBand[i] = band;
+                numBands[i] = bandsPerSubchannel[i];
+                band += bandsPerSubchannel[i];
+            }
+
+            int cells = numSubframes * numSubchannels;
+            subframeTime.resize(numSubframes);
+            sensed.resize(cells);
+            reserved.resize(cells);
+            priority.resize(cells);
+            resourceReservationInterval.resize(cells);
+            frequencyResourceLocation.resize(cells);
+            timeGapRetrans.resize(cells);
+            mcs.resize(cells);
+            retransmissionIndex.resize(cells);
+            sciSubchannelIndex.resize(cells);
+            sciLength.resize(cells);
+            rsrpValues.resize(cells * numRbs);
+            rssiValues.resize(cells * numRbs);
+
+            simtime_t time = firstSubframeTime;
+            for (int i = 0; i < numSubframes; i++)
+            {
+                reset(i, time);
+                time += TTI;
+            }
+        }
+
+        int getNumSubframes() const
+        {
+            return numSubframes;
+        }
+        int getNumSubchannels() const
+        {
+            return numSubchannels;
+        }
+
+        /**
+         * Clears all measurements and SCI info of a subframe, which is then
+         * considered sensed again from the given time.
+         */
+        void reset(int subframe, simtime_t simulationTime)
+        {
+            subframeTime[subframe] = simulationTime;
+            int start = index(subframe, 0);
+            int end = start + numSubchannels;
+            for (int i = start; i < end; i++)
+            {
+                reserved[i] = false;
+                sensed[i] = true;
+                priority[i] = 0;
+                resourceReservationInterval[i] = 0;
+                frequencyResourceLocation[i] = 0;
+                timeGapRetrans[i] = 0;
+                mcs[i] = 0;
+                retransmissionIndex[i] = 0;
+                sciSubchannelIndex[i] = 0;
+                sciLength[i] = 0;
+            }
+            std::fill(rsrpValues.begin() + start * numRbs, rsrpValues.begin() + end * numRbs, -std::numeric_limits<double>::infinity());
+            std::fill(rssiValues.begin() + start * numRbs, rssiValues.begin() + end * numRbs, -std::numeric_limits<double>::infinity());
+        }
+
+        simtime_t getSubframeTime(int subframe) const
+        {
+            return subframeTime[subframe];
+        }
+
+        Band getFirstBand(int subchannel) const
+        {
+            return firstBand[subchannel];
+        }
+        int getNumBands(int subchannel) const
+        {
+            return numBands[subchannel];
+        }
+
+        void setSensed(int subframe, int subchannel, bool value)
+        {
+            sensed[index(subframe, subchannel)] = value;
+        }
+        bool getSensed(int subframe, int subchannel) const
+        {
+            return sensed[index(subframe, subchannel)];
+        }
+        void setReserved(int subframe, int subchannel, bool value)
+        {
+            reserved[index(subframe, subchannel)] = value;
+        }
+        bool getReserved(int subframe, int subchannel) const
+        {
+            return reserved[index(subframe, subchannel)];
+        }
+
+        /**
+         * Records the SCI decoded on a subchannel and marks it as reserved.
+         */
+        void setSciInfo(int subframe, int subchannel, int prio, int rri, int frequencyLocation, int timeGap,
+                int mcsIndex, int retransmission, int subchannelIndex, int length)
+        {
+            int i = index(subframe, subchannel);
+            priority[i] = prio;
+            resourceReservationInterval[i] = rri;
+            frequencyResourceLocation[i] = frequencyLocation;
+            timeGapRetrans[i] = timeGap;
+            mcs[i] = mcsIndex;
+            retransmissionIndex[i] = retransmission;
+            sciSubchannelIndex[i] = subchannelIndex;
+            sciLength[i] = length;
+            reserved[i] = true;
+        }
+        int getPriority(int subframe, int subchannel) const
+        {
+            return priority[index(subframe, subchannel)];
+        }
+        int getResourceReservationInterval(int subframe, int subchannel) const
+        {
+            return resourceReservationInterval[index(subframe, subchannel)];
+        }
+        int getFrequencyResourceLocation(int subframe, int subchannel) const
+        {
+            return frequencyResourceLocation[index(subframe, subchannel)];
+        }
+        int getTimeGapRetrans(int subframe, int subchannel) const
+        {
+            return timeGapRetrans[index(subframe, subchannel)];
+        }
+        int getMcs(int subframe, int subchannel) const
+        {
+            return mcs[index(subframe, subchannel)];
+        }
+        int getRetransmissionIndex(int subframe, int subchannel) const
+        {
+            return retransmissionIndex[index(subframe, subchannel)];
+        }
+        int getSciSubchannelIndex(int subframe, int subchannel) const
+        {
+            return sciSubchannelIndex[index(subframe, subchannel)];
+        }
+        int getSciLength(int subframe, int subchannel) const
+        {
+            return sciLength[index(subframe, subchannel)];
+        }
+
+        /**
+         * Keeps the highest RSRP/RSSI seen on a band of the subchannel.
+         * Bands outside the subchannel are ignored.
+         */
+        void addRsrpValue(int subframe, int subchannel, double rsrpValue, Band band)
+        {
+            int slot = band - firstBand[subchannel];
+            if (slot < 0 || slot >= numBands[subchannel])
+                return;
+            double& value = rsrpValues[bandIndex(subframe, subchannel) + slot];
+            if (value < rsrpValue)
+                value = rsrpValue;
+        }
+        void addRssiValue(int subframe, int subchannel, double rssiValue, Band band)
+        {
+            int slot = band - firstBand[subchannel];
+            if (slot < 0 || slot >= numBands[subchannel])
+                return;
+            double& value = rssiValues[bandIndex(subframe, subchannel) + slot];
+            if (value < rssiValue)
+                value = rssiValue;
+        }
+
+        double getAverageRSRP(int subframe, int subchannel) const
+        {
+            const double* values = &rsrpValues[bandIndex(subframe, subchannel)];
+            bool measured = false;
+            double sum = 0;
+            for (int i = 0; i < numBands[subchannel]; i++)
+            {
+                if (values[i] != -std::numeric_limits<double>::infinity())
+                {
+                    sum += values[i];
+                    measured = true;
+                }
+            }
+            if (!measured)
+                return -std::numeric_limits<double>::infinity();
+            return sum / numRbs;
+        }
+        double getAverageRSSI(int subframe, int subchannel) const
+        {
+            return averageRssi(subframe, subchannel, numBands[subchannel]);
+        }
+        /**
+         * RSSI over the first two measured bands of the subchannel, i.e. the
+         * ones carrying the PSCCH when it is adjacent to the PSSCH.
+         */
+        double getAverageRSSIPscch(int subframe, int subchannel) const
+        {
+            return averageRssi(subframe, subchannel, 2);
+        }
+
+        /**
+         * Counts the sensed subchannels of a subframe and, among them, those
+         * whose PSSCH and PSCCH RSSI exceed the given threshold (used for CBR).
+         */
+        void countBusy(int subframe, double thresholdRSSI, int& sensedCount, int& busyCount, int& busyPscchCount) const
+        {
+            sensedCount = 0;
+            busyCount = 0;
+            busyPscchCount = 0;
+            for (int i = 0; i < numSubchannels; i++)
+            {
+                if (!sensed[index(subframe, i)])
+                    continue;
+                sensedCount++;
+                if (getAverageRSSI(subframe, i) > thresholdRSSI)
+                    busyCount++;
+                if (getAverageRSSIPscch(subframe, i) > thresholdRSSI)
+                    busyPscchCount++;
+            }
+        }
+
+    protected:
+        double averageRssi(int subframe, int subchannel, int maxCount) const
+        {
+            const double* values = &rssiValues[bandIndex(subframe, subchannel)];
+            int count = 0;
+            double sum = 0;
+            for (int i = 0; i < numBands[subchannel] && count < maxCount; i++)
+            {
+                if (values[i] != -std::numeric_limits<double>::infinity())
+                {
+                    sum += dBmToLinear(values[i]);
+                    count++;
+                }
+            }
+            if (count == 0)
+                return -std::numeric_limits<double>::infinity();
+            return linearToDBm(sum);
+        }
+};
+
+#endif
@@ -9,6 +9,110 @@
 
 #include "stack/phy/packet/LteAirFrame.h"
 
+SharedControlInfo::SharedControlInfo(UserControlInfo* info) :
+    cOwnedObject("sharedControlInfo", false)
+{
+    // the holder is created in the sender's context: detach it from the sender,
+    // and take the control info from it
+    removeFromOwnershipTree();
+    info_ = info;
+    cOwnedObject* ownedInfo = dynamic_cast<cOwnedObject*>(info_);
+    if (ownedInfo != NULL)
+        take(ownedInfo);
+    refCount_ = 1;
+}
+
+SharedControlInfo::~SharedControlInfo()
+{
+    cOwnedObject* ownedInfo = dynamic_cast<cOwnedObject*>(info_);
+    if (ownedInfo != NULL)
+        dropAndDelete(ownedInfo);
+    else
+        delete info_;
+}
+
+void SharedControlInfo::release()
+{
+    if (--refCount_ == 0)
+        delete this;
+}
+
+UserControlInfo* SharedControlInfo::releasePrivate()
+{
+    if (refCount_ > 1)
+    {
+        refCount_--;
+        return info_->dup();
+    }
+
+    // last holder, hand the shared copy over to the current module
+    UserControlInfo* info = info_;
+    cOwnedObject* ownedInfo = dynamic_cast<cOwnedObject*>(info);
+    if (ownedInfo != NULL)
+        drop(ownedInfo);
+    info_ = NULL;
+    delete this;
+    return info;
+}
+
+void LteAirFrame::copy(const LteAirFrame& other)
+{
+    this->remoteUnitPhyDataVector = other.remoteUnitPhyDataVector;
+
+    // copy the attached control info, if any
+    if (other.getControlInfo() != NULL)
+    {
+        UserControlInfo* info = check_and_cast<UserControlInfo*>(other.getControlInfo());
+        UserControlInfo* info_dup = info->dup();
+        this->setControlInfo(info_dup);
+    }
+
+    // share the shared control info, if any
+    if (other.sharedInfo_ != this->sharedInfo_)
+    {
+        releaseSharedInfo();
+        sharedInfo_ = other.sharedInfo_;
+        if (sharedInfo_ != NULL)
+            sharedInfo_->addRef();
+    }
+}
+
+void LteAirFrame::releaseSharedInfo()
+{
+    if (sharedInfo_ == NULL)
+        return;
+
+    sharedInfo_->release();
+    sharedInfo_ = NULL;
+}
+
+LteAirFrame* LteAirFrame::dupShared()
+{
+    if (sharedInfo_ == NULL && getControlInfo() != NULL)
+    {
+        // move the control info into the shared holder
+        sharedInfo_ = new SharedControlInfo(check_and_cast<UserControlInfo*>(removeControlInfo()));
+    }
+    return new LteAirFrame(*this);
+}
+
+const cObject* LteAirFrame::peekControlInfo() const
+{
+    if (getControlInfo() != NULL || sharedInfo_ == NULL)
+        return getControlInfo();
+    return sharedInfo_->getInfo();
+}
+
+cObject* LteAirFrame::removePrivateControlInfo()
+{
+    if (getControlInfo() != NULL || sharedInfo_ == NULL)
+        return removeControlInfo();
+
+    UserControlInfo* info = sharedInfo_->releasePrivate();
+    sharedInfo_ = NULL;
+    return info;
+}
+
 void LteAirFrame::addRemoteUnitPhyDataVector(RemoteUnitPhyData data)
 {
     remoteUnitPhyDataVector.push_back(data);
@@ -14,38 +14,103 @@
 #include "stack/phy/packet/LteAirFrame_m.h"
 #include "common/LteControlInfo.h"
 
+/**
+ * Control info shared among the copies of a broadcast LteAirFrame.
+ *
+ * The holder owns the control info and is not owned by any module, so the
+ * info survives the deletion of the sender while the copies are in flight.
+ * It is deleted by the last copy that releases it.
+ */
+class SharedControlInfo : public cOwnedObject
+{
+  protected:
+    UserControlInfo* info_;
+    unsigned int refCount_;
+
+  public:
+    SharedControlInfo(UserControlInfo* info);
+    virtual ~SharedControlInfo();
+
+    UserControlInfo* getInfo() const { return info_; }
+
+    void addRef() { refCount_++; }
+
+    /**
+     * Releases one reference to the control info, deleting the holder with
+     * the last one.
+     */
+    void release();
+
+    /**
+     * Releases one reference, returning a control info owned by the caller:
+     * the shared one if this was the last reference, a copy otherwise.
+     */
+    UserControlInfo* releasePrivate();
+};
+
 class LteAirFrame : public LteAirFrame_Base
 {
   protected:
     RemoteUnitPhyDataVector remoteUnitPhyDataVector;
-    public:
+    // control info shared with the other copies of this frame (NULL if not shared)
+    SharedControlInfo* sharedInfo_;
+
+    void copy(const LteAirFrame& other);
+    void releaseSharedInfo();
+
+  public:
     LteAirFrame(const char *name = NULL, int kind = 0) :
         LteAirFrame_Base(name, kind)
     {
+        sharedInfo_ = NULL;
     }
     LteAirFrame(const LteAirFrame& other) :
         LteAirFrame_Base(other)
     {
-        operator=(other);
+        sharedInfo_ = NULL;
+        copy(other);
+    }
+    virtual ~LteAirFrame()
+    {
+        releaseSharedInfo();
     }
     LteAirFrame& operator=(const LteAirFrame& other)
     {
+        if (this == &other)
+            return *this;
         LteAirFrame_Base::operator=(other);
-        this->remoteUnitPhyDataVector = other.remoteUnitPhyDataVector;
-
-        // copy the attached control info, if any
-        if (other.getControlInfo() != NULL)
-        {
-            UserControlInfo* info = check_and_cast<UserControlInfo*>(other.getControlInfo());
-            UserControlInfo* info_dup = info->dup();
-            this->setControlInfo(info_dup);
-        }
+        copy(other);
         return *this;
     }
     virtual LteAirFrame *dup() const
     {
         return new LteAirFrame(*this);
     }
+
+    /**
+     * Returns a lightweight copy of this frame, used to deliver a broadcast
+     * frame to many receivers.
+     *
+     * Instead of being duplicated, the control info is moved into a
+     * reference-counted holder shared by all the copies. The encapsulated
+     * payload is shared as well, and it is only duplicated when a receiver
+     * decapsulates it.
+     */
+    LteAirFrame* dupShared();
+
+    /**
+     * Returns the control info of the frame (either attached or shared),
+     * without taking it. The returned object must not be modified.
+     */
+    const cObject* peekControlInfo() const;
+
+    /**
+     * Removes the control info from the frame, as removeControlInfo().
+     * If the control info is shared with other frames, a private copy is
+     * returned (unless this is the last frame holding it).
+     */
+    cObject* removePrivateControlInfo();
+
     // ADD CODE HERE to redefine and implement pure virtual functions from LteAirFrame_Base
     void addRemoteUnitPhyDataVector(RemoteUnitPhyData data);
     RemoteUnitPhyDataVector getRemoteUnitPhyDataVector();
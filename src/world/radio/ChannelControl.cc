@@ -18,6 +18,7 @@
 #include "world/radio/ChannelControl.h"
 #include "inet/common/INETMath.h"
 #include <cassert>
+#include <algorithm>
 
 #include "stack/phy/packet/AirFrame_m.h"
 
@@ -66,12 +67,27 @@ void ChannelControl::initialize()
     lastOngoingTransmissionsUpdate = 0;
 
     maxInterferenceDistance = calcInterfDist();
+    neighborRange = calcNeighborRange();
+    // the neighbor grid cells are neighborRange wide
+    if (!(neighborRange > 0) || std::isinf(neighborRange))
+        throw cRuntimeError("ChannelControl::initialize - the neighbor range must be positive and finite, got %g: check pMax, sat, alpha and carrierFrequency", neighborRange);
+
+    numPositionUpdates = 0;
+    numDistanceChecks = 0;
 
     WATCH(maxInterferenceDistance);
+    WATCH(neighborRange);
     WATCH_LIST(radios);
     WATCH_VECTOR(transmissions);
 }
 
+void ChannelControl::finish()
+{
+    // the ratio between the two shows how the cost of a position update scales with the number of radios
+    recordScalar("positionUpdates", numPositionUpdates);
+    recordScalar("neighborDistanceChecks", numDistanceChecks);
+}
+
 /**
  * Calculation of the interference distance based on the transmitter
  * power, wavelength, pathloss coefficient and a threshold for the
@@ -105,6 +121,11 @@ double ChannelControl::calcInterfDist()
     return interfDistance;
 }
 
+double ChannelControl::calcNeighborRange()
+{
+    return maxInterferenceDistance;
+}
+
 ChannelControl::RadioRef ChannelControl::registerRadio(cModule *radio, cGate *radioInGate)
 {
     Enter_Method_Silent();
@@ -120,11 +141,14 @@ ChannelControl::RadioRef ChannelControl::registerRadio(cModule *radio, cGate *ra
     RadioEntry re;
     re.radioModule = radio;
     re.radioInGate = radioInGate->getPathStartGate();
-    re.isNeighborListValid = false;
     re.channel = 0;  // for now
     re.isActive = true;
+    // the radio enters the grid with its first position, see setRadioPosition()
+    re.hasPosition = false;
     radios.push_back(re);
-    return &radios.back(); // last element
+
+    radioRef = &radios.back(); // last element
+    return radioRef;
 }
 
 void ChannelControl::unregisterRadio(RadioRef r)
@@ -135,13 +159,17 @@ void ChannelControl::unregisterRadio(RadioRef r)
         if (it->radioModule == r->radioModule)
         {
             RadioRef radioToRemove = &*it;
-            // erase radio from all registered radios' neighbor list
-            for (RadioList::iterator i2 = radios.begin(); i2 != radios.end(); ++i2)
+            // erase radio from its neighbors' neighbor list (neighborhood is symmetric)
+            for (RadioRefVector::iterator i2 = radioToRemove->neighbors.begin(); i2 != radioToRemove->neighbors.end(); ++i2)
+                eraseNeighbor((*i2)->neighbors, radioToRemove);
+
+            // erase radio from the grid
+            if (radioToRemove->hasPosition)
             {
-                RadioRef otherRadio = &*i2;
-                otherRadio->neighbors.erase(radioToRemove);
-                otherRadio->isNeighborListValid = false;
-                radioToRemove->isNeighborListValid = false;
+                RadioRefVector& cellRadios = grid[radioToRemove->cell];
+                cellRadios.erase(std::find(cellRadios.begin(), cellRadios.end(), radioToRemove));
+                if (cellRadios.empty())
+                    grid.erase(radioToRemove->cell);
             }
 
             // erase radio from registered radios
@@ -165,49 +193,104 @@ ChannelControl::RadioRef ChannelControl::lookupRadio(cModule *radio)
 const ChannelControl::RadioRefVector& ChannelControl::getNeighbors(RadioRef h)
 {
     Enter_Method_Silent();
-    if (!h->isNeighborListValid)
-    {
-        h->neighborList.clear();
-        for (std::set<RadioRef,RadioEntry::Compare>::iterator it = h->neighbors.begin(); it != h->neighbors.end(); it++)
-            h->neighborList.push_back(*it);
-        h->isNeighborListValid = true;
-    }
-    return h->neighborList;
+    return h->neighbors;
+}
+
+ChannelControl::GridCell ChannelControl::getGridCell(const inet::Coord& pos)
+{
+    return GridCell((int)floor(pos.x / neighborRange), (int)floor(pos.y / neighborRange));
+}
+
+void ChannelControl::updateGridCell(RadioRef h)
+{
+    GridCell cell = getGridCell(h->pos);
+    if (cell == h->cell)
+        return;
+
+    RadioRefVector& oldCell = grid[h->cell];
+    oldCell.erase(std::find(oldCell.begin(), oldCell.end(), h));
+    if (oldCell.empty())
+        grid.erase(h->cell);
+
+    grid[cell].push_back(h);
+    h->cell = cell;
+}
+
+void ChannelControl::insertNeighbor(RadioRefVector& neighbors, RadioRef r)
+{
+    RadioRefVector::iterator it = std::lower_bound(neighbors.begin(), neighbors.end(), r, RadioEntry::Compare());
+    if (it == neighbors.end() || *it != r)
+        neighbors.insert(it, r);
+}
+
+void ChannelControl::eraseNeighbor(RadioRefVector& neighbors, RadioRef r)
+{
+    RadioRefVector::iterator it = std::lower_bound(neighbors.begin(), neighbors.end(), r, RadioEntry::Compare());
+    if (it != neighbors.end() && *it == r)
+        neighbors.erase(it);
 }
 
 void ChannelControl::updateConnections(RadioRef h)
 {
     inet::Coord& hpos = h->pos;
-    double maxDistSquared = maxInterferenceDistance * maxInterferenceDistance;
-    for (RadioList::iterator it = radios.begin(); it != radios.end(); ++it)
-    {
-        RadioEntry *hi = &(*it);
-        if (hi == h)
-            continue;
+    double maxDistSquared = neighborRange * neighborRange;
 
-        // get the distance between the two radios.
-        // (omitting the square root (calling sqrdist() instead of distance()) saves about 5% CPU)
-        bool inRange = hpos.sqrdist(hi->pos) < maxDistSquared;
+    numPositionUpdates++;
 
-        if (inRange)
+    // collect the radios in range. Since cells are neighborRange wide,
+    // all of them lie in the 3x3 cells around the one of the radio
+    RadioRefVector inRange;
+    for (int x = h->cell.first - 1; x <= h->cell.first + 1; x++)
+    {
+        for (int y = h->cell.second - 1; y <= h->cell.second + 1; y++)
         {
-            // nodes within communication range: connect
-            if (h->neighbors.insert(hi).second == true)
+            RadioGrid::iterator git = grid.find(GridCell(x, y));
+            if (git == grid.end())
+                continue;
+
+            for (RadioRefVector::iterator it = git->second.begin(); it != git->second.end(); ++it)
             {
-                hi->neighbors.insert(h);
-                h->isNeighborListValid = hi->isNeighborListValid = false;
+                RadioEntry *hi = *it;
+                if (hi == h)
+                    continue;
+
+                // get the distance between the two radios.
+                // (omitting the square root (calling sqrdist() instead of distance()) saves about 5% CPU)
+                numDistanceChecks++;
+                if (hpos.sqrdist(hi->pos) < maxDistSquared)
+                    inRange.push_back(hi);
             }
         }
-        else
+    }
+    std::sort(inRange.begin(), inRange.end(), RadioEntry::Compare());
+
+    // merge the new neighbor list with the old one, updating the lists of
+    // the radios that have been connected or disconnected
+    RadioEntry::Compare less;
+    RadioRefVector::iterator oldIt = h->neighbors.begin(), oldEnd = h->neighbors.end();
+    RadioRefVector::iterator newIt = inRange.begin(), newEnd = inRange.end();
+    while (oldIt != oldEnd || newIt != newEnd)
+    {
+        if (newIt == newEnd || (oldIt != oldEnd && less(*oldIt, *newIt)))
         {
             // out of range: disconnect
-            if (h->neighbors.erase(hi))
-            {
-                hi->neighbors.erase(h);
-                h->isNeighborListValid = hi->isNeighborListValid = false;
-            }
+            eraseNeighbor((*oldIt)->neighbors, h);
+            ++oldIt;
+        }
+        else if (oldIt == oldEnd || less(*newIt, *oldIt))
+        {
+            // nodes within communication range: connect
+            insertNeighbor((*newIt)->neighbors, h);
+            ++newIt;
+        }
+        else
+        {
+            // still in range
+            ++oldIt;
+            ++newIt;
         }
     }
+    h->neighbors.swap(inRange);
 }
 
 void ChannelControl::checkChannel(int channel)
@@ -220,6 +303,14 @@ void ChannelControl::setRadioPosition(RadioRef r, const inet::Coord& pos)
 {
     Enter_Method_Silent();
     r->pos = pos;
+    if (!r->hasPosition)
+    {
+        r->cell = getGridCell(pos);
+        grid[r->cell].push_back(r);
+        r->hasPosition = true;
+    }
+    else
+        updateGridCell(r);
     updateConnections(r);
 }
 
@@ -20,6 +20,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <map>
 
 #include "inet/common/INETDefs.h"
 #include "inet/common/geometry/common/Coord.h"
@@ -47,11 +48,11 @@ struct IChannelControl::RadioEntry {
             return lhs->radioModule->getId() < rhs->radioModule->getId();
         }
     };
-    // we cache neighbors set in an std::vector, because std::set iteration is slow;
-    // std::vector is created and updated on demand
-    std::set<RadioRef, Compare> neighbors; // cached neighbor list
-    std::vector<RadioRef> neighborList;
-    bool isNeighborListValid;
+    // neighbors are kept in a flat std::vector sorted by module id (see Compare),
+    // so that they can be iterated directly and merged with the new neighbor set
+    std::vector<RadioRef> neighbors; // cached neighbor list
+    std::pair<int, int> cell; // cell of the neighbor grid the radio lies in
+    bool hasPosition; // false until the first setRadioPosition(), the radio is not in the grid before
     bool isActive;
 };
 
@@ -69,6 +70,17 @@ class ChannelControl : public cSimpleModule, public IChannelControl
 
     RadioList radios;
 
+    /** radios bucketed by position on a grid whose cells are neighborRange wide,
+     * so that only the 3x3 cells around a radio have to be checked when it moves
+     */
+    typedef std::pair<int, int> GridCell;
+    typedef std::map<GridCell, RadioRefVector> RadioGrid;
+    RadioGrid grid;
+
+    /** number of position updates and of distance checks performed to update neighbor lists */
+    long numPositionUpdates;
+    long numDistanceChecks;
+
     /** keeps track of ongoing transmissions; this is needed when a radio
      * switches to another channel (then it needs to know whether the target channel
      * is empty or busy)
@@ -88,18 +100,37 @@ class ChannelControl : public cSimpleModule, public IChannelControl
     /** the biggest interference distance in the network.*/
     double maxInterferenceDistance;
 
+    /** distance within which radios are neighbors, and width of the grid cells */
+    double neighborRange;
+
     /** the number of controlled channels */
     int numChannels;
 
   protected:
     virtual void updateConnections(RadioRef h);
 
+    /** Returns the distance within which radios are neighbors, by default maxInterferenceDistance */
+    virtual double calcNeighborRange();
+
+    /** Returns the grid cell containing the given position */
+    virtual GridCell getGridCell(const inet::Coord& pos);
+
+    /** Moves the radio to the grid cell of its current position */
+    virtual void updateGridCell(RadioRef h);
+
+    /** Inserts/removes a radio in a neighbor list, keeping it sorted */
+    static void insertNeighbor(RadioRefVector& neighbors, RadioRef r);
+    static void eraseNeighbor(RadioRefVector& neighbors, RadioRef r);
+
     /** Calculate interference distance*/
     virtual double calcInterfDist();
 
     /** Reads init parameters and calculates a maximal interference distance*/
     virtual void initialize();
 
+    /** Records the cost of neighbor maintenance */
+    virtual void finish();
+
     /** Throws away expired transmissions. */
     virtual void purgeOngoingTransmissions();
 
@@ -12,6 +12,7 @@
 #include <cassert>
 
 #include "stack/phy/packet/AirFrame_m.h"
+#include "stack/phy/packet/LteAirFrame.h"
 
 #define coreEV EV << "LteChannelControl: "
 
@@ -33,7 +34,23 @@ LteChannelControl::~LteChannelControl()
 void LteChannelControl::initialize()
 {
     coreEV << "initializing LteChannelControl\n";
+
+    // read before the base class, which sizes the neighbor grid from it
+    deliveryRadius_ = par("deliveryRadius");
+    if (deliveryRadius_ == 0)
+        throw cRuntimeError("LteChannelControl::initialize - deliveryRadius must be either positive or negative (disabled)");
+
     ChannelControl::initialize();
+
+    shareAirFrames_ = par("shareAirFrames");
+    suppressedAirFrames_ = 0;
+}
+
+void LteChannelControl::finish()
+{
+    ChannelControl::finish();
+
+    recordScalar("suppressedAirFrames", suppressedAirFrames_);
 }
 
 /**
@@ -70,18 +87,38 @@ double LteChannelControl::calcInterfDist()
     return interfDistance;
 }
 
+double LteChannelControl::calcNeighborRange()
+{
+    if (deliveryRadius_ > 0 && !(deliveryRadius_ >= maxInterferenceDistance))
+        return deliveryRadius_;
+    return maxInterferenceDistance;
+}
+
 void LteChannelControl::sendToChannel(RadioRef srcRadio, AirFrame *airFrame)
 {
     // NOTE: no Enter_Method()! We pretend this method is part of ChannelAccess
 
+    // in shared mode, all the receivers get a lightweight copy of the frame,
+    // sharing control info and payload with the others
+    LteAirFrame* lteFrame = (shareAirFrames_) ? dynamic_cast<LteAirFrame*>(airFrame) : NULL;
+
+    // radios beyond the delivery radius cannot be affected by the frame: do not deliver it
+    double deliveryRadiusSquared = deliveryRadius_ * deliveryRadius_;
+
     // loop through all radios in range
     const RadioRefVector& neighbors = getNeighbors(srcRadio);
     for (unsigned int i=0; i<neighbors.size(); i++)
     {
         RadioRef r = neighbors[i];
+        if (deliveryRadius_ > 0 && srcRadio->pos.sqrdist(r->pos) >= deliveryRadiusSquared)
+        {
+            suppressedAirFrames_++;
+            continue;
+        }
         coreEV << "sending message to radio\n";
         simtime_t delay = 0.0;
-        check_and_cast<cSimpleModule*>(srcRadio->radioModule)->sendDirect(airFrame->dup(), delay, airFrame->getDuration(), r->radioInGate);
+        AirFrame* frameCopy = (lteFrame != NULL) ? lteFrame->dupShared() : airFrame->dup();
+        check_and_cast<cSimpleModule*>(srcRadio->radioModule)->sendDirect(frameCopy, delay, airFrame->getDuration(), r->radioInGate);
     }
 
     // the original frame can be deleted
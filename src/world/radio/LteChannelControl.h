@@ -22,12 +22,27 @@ class LteChannelControl : public ChannelControl
 {
   protected:
 
+    /** if true, broadcast frames are delivered as lightweight copies sharing control info and payload */
+    bool shareAirFrames_;
+
+    /** sender-side delivery radius (m). If negative, frames are delivered to all the neighbors */
+    double deliveryRadius_;
+
+    /** number of frame copies not delivered because the receiver is beyond the delivery radius */
+    long suppressedAirFrames_;
+
     /** Calculate interference distance*/
     virtual double calcInterfDist();
 
+    /** The delivery radius if set, as no frame is delivered beyond it, otherwise the interference distance */
+    virtual double calcNeighborRange();
+
     /** Reads init parameters and calculates a maximal interference distance*/
     virtual void initialize();
 
+    /** Records the number of suppressed deliveries */
+    virtual void finish();
+
   public:
     LteChannelControl();
     virtual ~LteChannelControl();